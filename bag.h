@@ -33,6 +33,19 @@
 
 #define FILLING_ARRAY true
 
+// Let merge() adopt partially-filled blocks from the other bag instead
+// of copying them into this bag's filling.  Requires FILLING_ARRAY.
+#ifndef FILLING_LIST
+#define FILLING_LIST FILLING_ARRAY
+#endif
+
+// Allocate a bag's arrays on first use, and grow its filling
+// geometrically from MIN_BLK_SIZE up to BLK_SIZE, so that empty
+// reducer views cost nothing.  Requires FILLING_ARRAY.
+#ifndef GROWING_FILLING
+#define GROWING_FILLING FILLING_ARRAY
+#endif
+
 // Macros for reducer testing
 #define REDUCER_ORIG                                                           \
   1 // Use the old C++ reducer syntax (no longer works in OpenCilk 2)
@@ -45,8 +58,18 @@
 #define REDUCER_IMPL REDUCER_PTRS
 #endif
 
+// Number of elements per pennant node; override with -DBAG_BLK_SIZE=<n>.
+#ifndef BAG_BLK_SIZE
+#define BAG_BLK_SIZE 2048
+#endif
+
 const uint32_t BAG_SIZE = 64;
-const uint32_t BLK_SIZE = 2048;
+const uint32_t BLK_SIZE = BAG_BLK_SIZE;
+// Maximum number of partially-filled blocks a bag holds before merge()
+// falls back to copying.
+const uint32_t MAX_PARTIALS = 8;
+// Initial capacity of a growing filling.
+const uint32_t MIN_BLK_SIZE = 16;
 
 template <typename T> class Bag;
 template <typename T> class Bag_reducer;
@@ -94,6 +117,23 @@ public: // HACKS
   // beyond last valid element.
   uint32_t size;
 
+#if GROWING_FILLING
+  // Number of elements the filling array can hold.
+  uint32_t cap;
+
+  inline void alloc_bag();
+  inline void reserve_filling(uint32_t n);
+#endif // GROWING_FILLING
+
+#if FILLING_LIST
+  // Partially-filled blocks adopted by merge(), and their sizes.
+  uint32_t npartials;
+  T *partials[MAX_PARTIALS];
+  uint32_t partialSize[MAX_PARTIALS];
+
+  inline void add_partial(T *blk, uint32_t size);
+#endif // FILLING_LIST
+
   inline void insert_h();
   inline void insert_fblk(T *fblk);
   inline void insert_blk(T *blk, uint32_t size);
@@ -115,6 +155,11 @@ public:
   inline Pennant<T> *getFirst() const;
   inline T *getFilling() const;
   inline uint32_t getFillingSize() const;
+#if FILLING_LIST
+  inline uint32_t getNumPartials() const;
+  inline T *getPartial(uint32_t) const;
+  inline uint32_t getPartialSize(uint32_t) const;
+#endif // FILLING_LIST
 
   void clear();
 
@@ -135,6 +180,59 @@ public:
 template <typename T>
 using Bag_red = Bag<T> cilk_reducer(Bag<T>::identity, Bag<T>::reduce);
 
+// N bags sharing a single reducer, for algorithms that need an array of
+// bag reducers, which REDUCER_ARRAY does not provide.  Each bag is
+// allocated on its first insertion, so that new views are cheap.
+template <typename T, int N> class Bag_array {
+public:
+  Bag<T> *bags[N];
+
+  Bag_array() {
+    for (int i = 0; i < N; ++i)
+      bags[i] = NULL;
+  }
+  ~Bag_array() {
+    for (int i = 0; i < N; ++i)
+      delete bags[i];
+  }
+
+  inline void insert(int i, T el) {
+    if (bags[i] == NULL)
+      bags[i] = new Bag<T>;
+    bags[i]->insert(el);
+  }
+  inline bool isEmpty(int i) const {
+    return bags[i] == NULL || bags[i]->isEmpty();
+  }
+  // Remove bag i and return it, or NULL if it was never allocated
+  inline Bag<T> *take(int i) {
+    Bag<T> *b = bags[i];
+    bags[i] = NULL;
+    return b;
+  }
+
+  static void identity(void *view) { new (view) Bag_array; }
+  static void reduce(void *left, void *right) {
+    Bag_array *l = static_cast<Bag_array *>(left);
+    Bag_array *r = static_cast<Bag_array *>(right);
+    for (int i = 0; i < N; ++i) {
+      if (r->bags[i] == NULL)
+        continue;
+      if (l->bags[i] == NULL)
+        l->bags[i] = r->take(i);
+      else
+        l->bags[i]->merge(r->bags[i]);
+    }
+    r->~Bag_array();
+  }
+};
+
+// The parentheses keep the commas out of the macro's arguments
+template <typename T, int N>
+using Bag_array_red =
+    Bag_array<T, N> cilk_reducer((Bag_array<T, N>::identity),
+                                 (Bag_array<T, N>::reduce));
+
 #else // REDUCER_IMPL
 
 template <typename T> class Bag_reducer {
@@ -219,6 +317,7 @@ template <typename T> inline void Bag_reducer<T>::clear() {
 #endif // REDUCER_IMPL
 
 template <typename T> T MAX(T a, T b) { return (a > b) ? a : b; }
+template <typename T> T MIN(T a, T b) { return (a < b) ? a : b; }
 
 //////////////////////////////////
 ///                            ///
@@ -280,12 +379,21 @@ template <typename T> inline Pennant<T> *Pennant<T>::split() {
 ///                        ///
 //////////////////////////////
 template <typename T> Bag<T>::Bag() : fill(0), size(0) {
+#if FILLING_LIST
+  this->npartials = 0;
+#endif // FILLING_LIST
+#if GROWING_FILLING
+  this->cap = 0;
+  this->bag = NULL;
+  this->filling = NULL;
+#else
   this->bag = new Pennant<T> *[BAG_SIZE];
 #if FILLING_ARRAY
   this->filling = new T[BLK_SIZE];
 #else
   this->filling = new Pennant<T>();
 #endif
+#endif // GROWING_FILLING
 }
 
 /*
@@ -296,10 +404,21 @@ template <typename T> Bag<T>::Bag() : fill(0), size(0) {
 template <typename T>
 Bag<T>::Bag(Bag<T> *that) : fill(that->fill), size(that->size) {
   this->bag = new Pennant<T> *[BAG_SIZE];
-  for (uint32_t i = 0; i < BAG_SIZE; i++)
+  for (uint32_t i = 0; i < that->fill; i++)
     this->bag[i] = that->bag[i];
 
   this->filling = that->filling;
+#if GROWING_FILLING
+  this->cap = that->cap;
+#endif // GROWING_FILLING
+
+#if FILLING_LIST
+  this->npartials = that->npartials;
+  for (uint32_t i = 0; i < that->npartials; i++) {
+    this->partials[i] = that->partials[i];
+    this->partialSize[i] = that->partialSize[i];
+  }
+#endif // FILLING_LIST
 }
 
 template <typename T> Bag<T>::~Bag() {
@@ -318,10 +437,18 @@ template <typename T> Bag<T>::~Bag() {
 #else
   delete this->filling;
 #endif // FILLING_ARRAY
+#if FILLING_LIST
+  for (uint32_t i = 0; i < this->npartials; i++)
+    delete[] this->partials[i];
+#endif // FILLING_LIST
 }
 
 template <typename T> inline uint32_t Bag<T>::numElements() const {
   uint32_t count = this->size;
+#if FILLING_LIST
+  for (uint32_t i = 0; i < this->npartials; i++)
+    count += this->partialSize[i];
+#endif // FILLING_LIST
   uint32_t k = 1;
   for (uint32_t i = 0; i < this->fill; i++) {
     if (this->bag[i] != NULL)
@@ -332,11 +459,42 @@ template <typename T> inline uint32_t Bag<T>::numElements() const {
   return count;
 }
 
+#if GROWING_FILLING
+// Allocate the pennant array, if it has not been allocated yet
+template <typename T> inline void Bag<T>::alloc_bag() {
+  if (this->bag == NULL)
+    this->bag = new Pennant<T> *[BAG_SIZE];
+}
+
+// Grow the filling geometrically until it can hold at least n elements
+template <typename T> inline void Bag<T>::reserve_filling(uint32_t n) {
+  if (n <= this->cap)
+    return;
+
+  uint32_t newcap = this->cap < MIN_BLK_SIZE ? MIN_BLK_SIZE : this->cap;
+  while (newcap < n)
+    newcap *= 2;
+  if (newcap > BLK_SIZE)
+    newcap = BLK_SIZE;
+
+  T *newfilling = new T[newcap];
+  if (this->size > 0)
+    memcpy(newfilling, this->filling, this->size * sizeof(T));
+  delete[] this->filling;
+  this->filling = newfilling;
+  this->cap = newcap;
+}
+#endif // GROWING_FILLING
+
 // helper routine to perform bag-insert with filled filling array
 template <typename T> inline void Bag<T>::insert_h() {
 #if FILLING_ARRAY
   Pennant<T> *c = new Pennant<T>(this->filling);
   this->filling = new T[BLK_SIZE];
+#if GROWING_FILLING
+  this->cap = BLK_SIZE;
+  alloc_bag();
+#endif // GROWING_FILLING
 #else
   Pennant<T> *c = this->filling;
   this->filling = new Pennant<T>();
@@ -382,6 +540,9 @@ template <typename T> inline void Bag<T>::insert_h() {
 // helper routine to perform bag-insert with filled filling array
 template <typename T> inline void Bag<T>::insert_fblk(T fblk[]) {
   Pennant<T> *c = new Pennant<T>(fblk);
+#if GROWING_FILLING
+  alloc_bag();
+#endif // GROWING_FILLING
 
   uint32_t i = 0;
   do {
@@ -420,8 +581,17 @@ template <typename T> inline void Bag<T>::insert_fblk(T fblk[]) {
 template <typename T> inline void Bag<T>::insert_blk(T blk[], uint32_t size) {
   int i;
 
+#if GROWING_FILLING
+  // blk may have room for only size elements, so always copy into
+  // this->filling.
+  reserve_filling(MIN(BLK_SIZE, this->size + size));
+  const bool intoBlk = false;
+#else
+  const bool intoBlk = this->size < size;
+#endif // GROWING_FILLING
+
   // Deal with the partially-filled Pennants
-  if (this->size < size) {
+  if (intoBlk) {
     // Copy contents of this->filling into blk
     i = this->size - (BLK_SIZE - size);
 
@@ -469,6 +639,9 @@ template <typename T> inline void Bag<T>::insert_blk(T blk[], uint32_t size) {
 
       carry = this->filling;
       this->filling = blk;
+#if GROWING_FILLING
+      this->cap = size;
+#endif // GROWING_FILLING
 
 #else
       memcpy(this->filling->els + this->size, blk + i,
@@ -492,12 +665,36 @@ template <typename T> inline void Bag<T>::insert_blk(T blk[], uint32_t size) {
 #endif // FILLING_ARRAY
        //}
       this->size += size;
+      delete[] blk;
     }
   }
 }
 
+#if FILLING_LIST
+// Adopt the partially-filled block blk, holding size elements, without
+// copying it.  If this bag already holds MAX_PARTIALS such blocks, blk
+// is coalesced into the filling instead.
+template <typename T> inline void Bag<T>::add_partial(T blk[], uint32_t size) {
+  if (size == 0) {
+    delete[] blk;
+    return;
+  }
+  if (this->npartials < MAX_PARTIALS) {
+    this->partials[this->npartials] = blk;
+    this->partialSize[this->npartials] = size;
+    this->npartials++;
+    return;
+  }
+  insert_blk(blk, size);
+}
+#endif // FILLING_LIST
+
 template <typename T> inline void Bag<T>::insert(T el) {
   // assert(this->size < BLK_SIZE);
+#if GROWING_FILLING
+  if (this->size == this->cap)
+    reserve_filling(this->size + 1);
+#endif // GROWING_FILLING
 #if FILLING_ARRAY
   this->filling[this->size++] = el;
 #else
@@ -511,6 +708,10 @@ template <typename T> inline void Bag<T>::insert(T el) {
 #if FILLING_ARRAY
   Pennant<T> *c = new Pennant<T>(this->filling);
   this->filling = new T[BLK_SIZE];
+#if GROWING_FILLING
+  this->cap = BLK_SIZE;
+  alloc_bag();
+#endif // GROWING_FILLING
 #else
   Pennant<T> *c = this->filling;
   this->filling = new Pennant<T>();
@@ -550,11 +751,23 @@ template <typename T> void Bag<T>::merge(Bag<T> *that) {
   char x;
   int i;
 
+#if FILLING_LIST
+  // Adopt that's partially-filled blocks.  They are coalesced only when
+  // the bag is walked.
+  for (uint32_t k = 0; k < that->npartials; k++)
+    add_partial(that->partials[k], that->partialSize[k]);
+  that->npartials = 0;
+  add_partial(that->filling, that->size);
+  that->size = 0;
+#else
   // Deal with the partially-filled Pennants
   if (this->size < that->size) {
     i = this->size - (BLK_SIZE - that->size);
 
     if (i >= 0) {
+#if GROWING_FILLING
+      that->reserve_filling(BLK_SIZE);
+#endif // GROWING_FILLING
 #if FILLING_ARRAY
       memcpy(that->filling + that->size, this->filling + i,
              (BLK_SIZE - that->size) * sizeof(T));
@@ -569,8 +782,14 @@ template <typename T> void Bag<T>::merge(Bag<T> *that) {
       this->size = i;
     } else {
       // if (this->size > 0) {
+#if GROWING_FILLING
+      that->reserve_filling(that->size + this->size);
+      this->cap = that->cap;
+#endif // GROWING_FILLING
 #if FILLING_ARRAY
-      memcpy(that->filling + that->size, this->filling, this->size * sizeof(T));
+      if (this->size > 0)
+        memcpy(that->filling + that->size, this->filling,
+               this->size * sizeof(T));
 #else
       memcpy(that->filling->els + that->size, this->filling->els,
              this->size * sizeof(T));
@@ -591,6 +810,9 @@ template <typename T> void Bag<T>::merge(Bag<T> *that) {
 
     if (i >= 0) {
 
+#if GROWING_FILLING
+      reserve_filling(BLK_SIZE);
+#endif // GROWING_FILLING
 #if FILLING_ARRAY
       memcpy(this->filling + this->size, that->filling + i,
              (BLK_SIZE - this->size) * sizeof(T));
@@ -604,12 +826,21 @@ template <typename T> void Bag<T>::merge(Bag<T> *that) {
 #endif // FILLING_ARRAY
 
       this->filling = that->filling;
+#if GROWING_FILLING
+      this->cap = that->cap;
+#endif // GROWING_FILLING
       this->size = i;
     } else {
 
       // if (that->size > 0) {
+#if GROWING_FILLING
+      reserve_filling(this->size + that->size);
+#endif // GROWING_FILLING
 #if FILLING_ARRAY
-      memcpy(this->filling + this->size, that->filling, that->size * sizeof(T));
+      if (that->size > 0)
+        memcpy(this->filling + this->size, that->filling,
+               that->size * sizeof(T));
+      delete[] that->filling;
 #else
       memcpy(this->filling->els + this->size, that->filling->els,
              that->size * sizeof(T));
@@ -618,8 +849,23 @@ template <typename T> void Bag<T>::merge(Bag<T> *that) {
       this->size += that->size;
     }
   }
+#endif // FILLING_LIST
 
   that->filling = NULL;
+  that->size = 0;
+
+#if GROWING_FILLING
+  // A later insert into that must allocate a new filling
+  that->cap = 0;
+
+  // Take that's pennant array if this bag has not allocated one yet
+  if (this->bag == NULL) {
+    this->bag = that->bag;
+    this->fill = that->fill;
+    that->bag = NULL;
+    that->fill = 0;
+  }
+#endif // GROWING_FILLING
 
   // Update this->fill (assuming no final carry)
   // uint32_t min, max;
@@ -636,6 +882,10 @@ template <typename T> void Bag<T>::merge(Bag<T> *that) {
   if (carry != NULL)
     c = new Pennant<T>(carry);
 #endif // FILLING_ARRAY
+#if GROWING_FILLING
+  if (c != NULL)
+    alloc_bag();
+#endif // GROWING_FILLING
 
   // Merge
   for (i = 0; i < min; ++i) {
@@ -816,10 +1066,18 @@ template <typename T> inline uint32_t Bag<T>::getFill() const {
 }
 
 template <typename T> inline bool Bag<T>::isEmpty() const {
+#if FILLING_LIST
+  return this->fill == 0 && this->size == 0 && this->npartials == 0;
+#else
   return this->fill == 0 && this->size == 0;
+#endif // FILLING_LIST
 }
 
 template <typename T> inline Pennant<T> *Bag<T>::getFirst() const {
+#if GROWING_FILLING
+  if (this->bag == NULL)
+    return NULL;
+#endif // GROWING_FILLING
   return this->bag[0];
 }
 
@@ -835,9 +1093,28 @@ template <typename T> inline uint32_t Bag<T>::getFillingSize() const {
   return this->size;
 }
 
+#if FILLING_LIST
+template <typename T> inline uint32_t Bag<T>::getNumPartials() const {
+  return this->npartials;
+}
+
+template <typename T> inline T *Bag<T>::getPartial(uint32_t i) const {
+  return this->partials[i];
+}
+
+template <typename T> inline uint32_t Bag<T>::getPartialSize(uint32_t i) const {
+  return this->partialSize[i];
+}
+#endif // FILLING_LIST
+
 template <typename T> inline void Bag<T>::clear() {
   this->fill = 0;
   this->size = 0;
+#if FILLING_LIST
+  for (uint32_t i = 0; i < this->npartials; i++)
+    delete[] this->partials[i];
+  this->npartials = 0;
+#endif // FILLING_LIST
 }
 
 #endif
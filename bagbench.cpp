@@ -0,0 +1,418 @@
+// Copyright (c) 2010-2024, Tao B. Schardl
+/*
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// Microbenchmark and stress test for Bag and Pennant.  The benchmark
+// measures insert, merge, split and walk throughput for several
+// element types.  Build with -DBAG_BLK_SIZE=<n> to vary BLK_SIZE, and
+// run under different values of CILK_NWORKERS to vary the worker count.
+
+#include "bag.h"
+#include <cilk/cilk.h>
+#include <cilk/cilk_api.h>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <sys/time.h>
+
+using namespace std;
+
+const int TRIALS = 5;
+const int STRESS_ROUNDS = 20;
+
+// Structure defining command line argument values
+typedef struct {
+  int n;
+  int k;
+  bool header;
+  bool stress;
+  unsigned long seed;
+  bool reducer_array;
+} BagBenchArgs;
+
+static unsigned long long todval(struct timeval *tp) {
+  return tp->tv_sec * 1000 * 1000 + tp->tv_usec;
+}
+
+static void print_usage(char *argv0) {
+  fprintf(stderr,
+          "Usage: %s [-n <elements>] [-k <bags>] [-q] [-s <seed>] [-r]\n",
+          argv0);
+  fprintf(stderr, "Flags are:\n");
+  fprintf(stderr, "\t-n <elements>\t: Number of elements to insert.\n");
+  fprintf(stderr, "\t-k <bags>\t: Number of bags to merge.\n");
+  fprintf(stderr, "\t-q\t\t: Do not print the CSV header.\n");
+  fprintf(stderr,
+          "\t-s <seed>\t: Run the randomized stress test instead of the "
+          "benchmark.\n");
+  fprintf(stderr, "\t-r\t\t: Exercise an array of Bag reducers "
+                  "(REDUCER_ARRAY).\n");
+  exit(1);
+}
+
+static BagBenchArgs parse_args(int argc, char *argv[]) {
+  BagBenchArgs theArgs;
+  theArgs.n = 1 << 24;
+  theArgs.k = 1024;
+  theArgs.header = true;
+  theArgs.stress = false;
+  theArgs.seed = 0;
+  theArgs.reducer_array = false;
+
+  for (int arg_i = 1; arg_i < argc; ++arg_i) {
+    char *arg = argv[arg_i];
+
+    if (strcmp(arg, "-n") == 0 && arg_i + 1 < argc) {
+      theArgs.n = atoi(argv[++arg_i]);
+    } else if (strcmp(arg, "-k") == 0 && arg_i + 1 < argc) {
+      theArgs.k = atoi(argv[++arg_i]);
+    } else if (strcmp(arg, "-q") == 0) {
+      theArgs.header = false;
+    } else if (strcmp(arg, "-s") == 0 && arg_i + 1 < argc) {
+      theArgs.stress = true;
+      theArgs.seed = strtoul(argv[++arg_i], NULL, 0);
+    } else if (strcmp(arg, "-r") == 0) {
+      theArgs.reducer_array = true;
+    } else {
+      print_usage(argv[0]);
+    }
+  }
+  if (theArgs.n <= 0 || theArgs.k <= 0)
+    print_usage(argv[0]);
+
+  return theArgs;
+}
+
+// Counter-based hash, so that any strand can compute the i-th random
+// value without shared state.
+static inline uint64_t hash64(uint64_t seed, uint64_t i) {
+  uint64_t z = seed + (i + 1) * 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+template <typename T> static const char *type_name();
+template <> const char *type_name<int>() { return "int"; }
+template <> const char *type_name<long>() { return "long"; }
+
+template <typename T>
+static void report(const char *op, int n, unsigned long long us) {
+  printf("%s,%s,%u,%u,%d,%f,%f\n", op, type_name<T>(), BLK_SIZE,
+         __cilkrts_get_nworkers(), n, us / 1000000.0,
+         us > 0 ? (double)n / us : 0.0);
+}
+
+// Destructively split a pennant holding 2^k blocks down to single
+// blocks.  Returns the number of blocks.
+template <typename T> static int split_Pennant(Pennant<T> *p, int k) {
+  if (k == 0) {
+    delete p;
+    return 1;
+  }
+  Pennant<T> *q = p->split();
+  int left = cilk_spawn split_Pennant(q, k - 1);
+  int right = split_Pennant(p, k - 1);
+  cilk_sync;
+  return left + right;
+}
+
+// Merge bags[lo..hi) into bags[lo] as a balanced tree of merges.
+template <typename T> static void merge_tree(Bag<T> *bags[], int lo, int hi) {
+  if (hi - lo < 2)
+    return;
+  int mid = lo + (hi - lo) / 2;
+  cilk_spawn merge_tree(bags, lo, mid);
+  merge_tree(bags, mid, hi);
+  cilk_sync;
+  bags[lo]->merge(bags[mid]);
+  delete bags[mid];
+}
+
+// Apply f to every element of the block n[0..size)
+template <typename T, typename F>
+static void walk_Filling(const T n[], uint32_t size, const F &f) {
+  cilk_for(uint32_t i = 0; i < size; ++i) f(n[i]);
+}
+
+// Walk the pennant, in the same way as walk_Pennant in bagwalk.h, and
+// delete it.
+template <typename T, typename F>
+static void walk_Pennant(Pennant<T> *p, const F &f) {
+  if (p->getLeft() != NULL)
+    cilk_spawn walk_Pennant(p->getLeft(), f);
+  if (p->getRight() != NULL)
+    cilk_spawn walk_Pennant(p->getRight(), f);
+  walk_Filling(p->getElements(), BLK_SIZE, f);
+  cilk_sync;
+  delete p;
+}
+
+// Walk the bag, in the same way as walk_Bag in bagwalk.h.  Destroys the
+// pennants in the bag.
+template <typename T, typename F> static void walk_Bag(Bag<T> &b, const F &f) {
+  if (b.getFill() > 0) {
+    Pennant<T> *p = NULL;
+    b.split(&p);
+    cilk_spawn walk_Pennant(p, f);
+    walk_Bag(b, f);
+  } else {
+#if FILLING_LIST
+    for (uint32_t k = 0; k < b.getNumPartials(); ++k)
+      cilk_spawn walk_Filling(b.getPartial(k), b.getPartialSize(k), f);
+#endif // FILLING_LIST
+    walk_Filling(b.getFilling(), b.getFillingSize(), f);
+  }
+}
+
+template <typename T> static void bench_insert(int n) {
+  for (int t = 0; t < TRIALS; ++t) {
+    struct timeval t1, t2;
+    Bag_red<T> b;
+    gettimeofday(&t1, 0);
+    cilk_for(int i = 0; i < n; ++i) b.insert(i);
+    gettimeofday(&t2, 0);
+    if (b.numElements() != (uint32_t)n)
+      fprintf(stderr, "insert: expected %d elements, found %u\n", n,
+              b.numElements());
+    report<T>("insert", n, todval(&t2) - todval(&t1));
+  }
+}
+
+template <typename T> static void bench_merge(int n, int k) {
+  Bag<T> **bags = new Bag<T> *[k];
+  for (int t = 0; t < TRIALS; ++t) {
+    struct timeval t1, t2;
+    cilk_for(int j = 0; j < k; ++j) {
+      bags[j] = new Bag<T>();
+      // Vary sizes so that the fillings are partial
+      for (int i = j; i < n; i += k)
+        bags[j]->insert(i);
+    }
+    gettimeofday(&t1, 0);
+    merge_tree(bags, 0, k);
+    gettimeofday(&t2, 0);
+    if (bags[0]->numElements() != (uint32_t)n)
+      fprintf(stderr, "merge: expected %d elements, found %u\n", n,
+              bags[0]->numElements());
+    delete bags[0];
+    report<T>("merge", k, todval(&t2) - todval(&t1));
+  }
+  delete[] bags;
+}
+
+template <typename T> static void bench_split(int n) {
+  for (int t = 0; t < TRIALS; ++t) {
+    struct timeval t1, t2;
+    Bag<T> b;
+    for (int i = 0; i < n; ++i)
+      b.insert(i);
+    int blocks = 0;
+    gettimeofday(&t1, 0);
+    while (b.getFill() > 0) {
+      Pennant<T> *p;
+      int k = b.getFill() - 1;
+      b.split(&p);
+      blocks += split_Pennant(p, k);
+    }
+    gettimeofday(&t2, 0);
+    if (blocks != n / (int)BLK_SIZE)
+      fprintf(stderr, "split: expected %d blocks, found %d\n", n / BLK_SIZE,
+              blocks);
+    report<T>("split", blocks, todval(&t2) - todval(&t1));
+  }
+}
+
+template <typename T> static void bench_walk(int n) {
+  char *seen = new char[n];
+  for (int t = 0; t < TRIALS; ++t) {
+    struct timeval t1, t2;
+    Bag_red<T> b;
+    cilk_for(int i = 0; i < n; ++i) {
+      seen[i] = 0;
+      b.insert(i);
+    }
+    gettimeofday(&t1, 0);
+    walk_Bag(*&b, [seen](T x) { seen[x] = 1; });
+    gettimeofday(&t2, 0);
+    for (int i = 0; i < n; ++i) {
+      if (!seen[i]) {
+        fprintf(stderr, "walk: element %d not found\n", i);
+        break;
+      }
+    }
+    report<T>("walk", n, todval(&t2) - todval(&t1));
+  }
+  delete[] seen;
+}
+
+// Insert the values hash(seed, i) % range for i in [lo, hi) into b,
+// splitting the range at random points so that the reductions of b
+// follow an irregular tree.
+template <typename T>
+static void insert_random(Bag_red<T> &b, int lo, int hi, int range,
+                          uint64_t seed) {
+  uint64_t r = hash64(seed ^ 0x5bd1e995, (uint64_t)lo * 31 + hi);
+  if (hi - lo <= 1 + (int)(r % 4096)) {
+    for (int i = lo; i < hi; ++i)
+      b.insert((T)(hash64(seed, i) % range));
+    return;
+  }
+  int mid = lo + 1 + (int)(r % (hi - lo - 1));
+  cilk_spawn insert_random(b, lo, mid, range, seed);
+  insert_random(b, mid, hi, range, seed);
+}
+
+// Split the pennant holding 2^k blocks to a random depth, then walk the
+// pieces.
+template <typename T, typename F>
+static void split_walk_Pennant(Pennant<T> *p, int k, uint64_t seed,
+                               const F &f) {
+  if (k > 0 && hash64(seed, k) % 2 == 0) {
+    Pennant<T> *q = p->split();
+    cilk_spawn split_walk_Pennant(q, k - 1, seed * 3 + 1, f);
+    split_walk_Pennant(p, k - 1, seed * 3 + 2, f);
+    cilk_sync;
+  } else {
+    walk_Pennant(p, f);
+  }
+}
+
+// Check that the multiset of elements in the bags survives reducer
+// merges, explicit merges, and splits.
+template <typename T> static bool stress(int maxn, uint64_t seed) {
+  bool ok = true;
+  for (int round = 0; round < STRESS_ROUNDS && ok; ++round) {
+    uint64_t rseed = hash64(seed, round);
+    int k = 1 + (int)(rseed % 64);
+    int range = 1 + (int)(hash64(rseed, 1) % maxn);
+    int *sizes = new int[k];
+    int *expected = new int[range];
+    int *found = new int[range];
+    for (int v = 0; v < range; ++v) {
+      expected[v] = 0;
+      found[v] = 0;
+    }
+
+    // Fill k bags through reducers, with random sizes
+    Bag<T> **bags = new Bag<T> *[k];
+    for (int j = 0; j < k; ++j) {
+      sizes[j] = (int)(hash64(rseed, j + 2) % (maxn / k + 1));
+      Bag_red<T> b;
+      insert_random(b, 0, sizes[j], range, rseed + j);
+      for (int i = 0; i < sizes[j]; ++i)
+        expected[hash64(rseed + j, i) % range]++;
+      bags[j] = new Bag<T>();
+      bags[j]->merge(&b);
+    }
+
+    // Merge them in a random order
+    for (int j = k - 1; j > 0; --j) {
+      int i = (int)(hash64(rseed, j + k + 2) % j);
+      bags[i]->merge(bags[j]);
+      delete bags[j];
+    }
+
+    // Split and walk, counting every element
+    Bag<T> *b = bags[0];
+    while (b->getFill() > 0) {
+      Pennant<T> *p;
+      int h = b->getFill() - 1;
+      b->split(&p);
+      split_walk_Pennant(p, h, rseed + h, [found](T x) {
+        __atomic_fetch_add(&found[x], 1, __ATOMIC_RELAXED);
+      });
+    }
+    walk_Bag(*b, [found](T x) {
+      __atomic_fetch_add(&found[x], 1, __ATOMIC_RELAXED);
+    });
+
+    for (int v = 0; v < range; ++v) {
+      if (expected[v] != found[v]) {
+        fprintf(stderr,
+                "stress<%s>: seed %lu round %d: value %d expected %d times, "
+                "found %d\n",
+                type_name<T>(), (unsigned long)seed, round, v, expected[v],
+                found[v]);
+        ok = false;
+        break;
+      }
+    }
+
+    delete b;
+    delete[] bags;
+    delete[] sizes;
+    delete[] expected;
+    delete[] found;
+  }
+  printf("stress,%s,%u,%u,%s\n", type_name<T>(), BLK_SIZE,
+         __cilkrts_get_nworkers(), ok ? "ok" : "FAILED");
+  return ok;
+}
+
+// Reproducer for the REDUCER_ARRAY configuration noted in bag.h: an
+// array of two Bag reducers used as alternating frontiers.
+template <typename T> static void reducer_array(int n) {
+  Bag_red<T> queue[2];
+  bool queuei = 1;
+
+  for (int round = 0; round < 16; ++round) {
+    queue[!queuei].clear();
+    cilk_for(int i = 0; i < n; ++i) queue[!queuei].insert(i);
+    if (queue[!queuei].numElements() != (uint32_t)n)
+      fprintf(stderr, "reducer array: expected %d elements, found %u\n", n,
+              queue[!queuei].numElements());
+    queuei = !queuei;
+  }
+  printf("reducer_array,%s,%u,%u,ok\n", type_name<T>(), BLK_SIZE,
+         __cilkrts_get_nworkers());
+}
+
+template <typename T> static void bench(int n, int k) {
+  bench_insert<T>(n);
+  bench_merge<T>(n, k);
+  bench_split<T>(n);
+  bench_walk<T>(n);
+}
+
+int main(int argc, char **argv) {
+  BagBenchArgs args = parse_args(argc, argv);
+
+  if (args.reducer_array) {
+    reducer_array<int>(args.n);
+    return 0;
+  }
+
+  if (args.stress) {
+    bool ok = stress<int>(args.n, args.seed);
+    ok = stress<long>(args.n, args.seed) && ok;
+    return ok ? 0 : 1;
+  }
+
+  if (args.header)
+    printf("op,type,blk_size,workers,count,seconds,per_us\n");
+  bench<int>(args.n, args.k);
+  bench<long>(args.n, args.k);
+
+  return 0;
+}
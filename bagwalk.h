@@ -0,0 +1,96 @@
+// Copyright (c) 2010-2024, Tao B. Schardl
+/*
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BAGWALK_H
+#define BAGWALK_H
+
+// The parallel walk over a frontier Bag that the traversals share.  A
+// traversal supplies the function that processes a block of nodes,
+// which takes the block, the reducer that collects the next frontier,
+// and the traversal's state for the layer.
+
+#include "bag.h"
+#include <cilk/cilk.h>
+
+// Nodes processed serially by each leaf of a walk.  May be overridden
+// at compile time, e.g., with the value that graphstats recommends.
+#ifndef THRESHOLD
+#define THRESHOLD 256
+#endif
+
+static_assert(BLK_SIZE % THRESHOLD == 0, "THRESHOLD must divide BLK_SIZE");
+
+// Process the block n[0..fillSize) in leaves of THRESHOLD nodes, each
+// handed to procNode
+template <typename Red, typename Phase,
+          void (*procNode)(const int[], int, Red &, const Phase &)>
+void walk_Filling(const int n[], int fillSize, Red &next, const Phase &ph) {
+  int extraFill = fillSize % THRESHOLD;
+  if (extraFill > 0)
+    cilk_spawn procNode(n + fillSize - extraFill, extraFill, next, ph);
+  cilk_for(int i = 0; i < fillSize - extraFill; i += THRESHOLD) {
+    procNode(n + i, THRESHOLD, next, ph);
+  }
+}
+
+// Walk the pennant, handing each of its blocks to walkBlock, and delete
+// it
+template <typename Red, typename Phase,
+          void (*walkBlock)(const int[], int, Red &, const Phase &)>
+void walk_Pennant(Pennant<int> *p, Red &next, const Phase &ph) {
+  cilk_scope {
+    if (p->getLeft() != NULL)
+      cilk_spawn walk_Pennant<Red, Phase, walkBlock>(p->getLeft(), next, ph);
+
+    if (p->getRight() != NULL)
+      cilk_spawn walk_Pennant<Red, Phase, walkBlock>(p->getRight(), next,
+                                                     ph);
+
+    walkBlock(p->getElements(), BLK_SIZE, next, ph);
+  }
+  delete p;
+}
+
+// Walk the bag, handing each of its blocks to walkBlock.  Destroys the
+// pennants in the bag.
+template <typename Red, typename Phase,
+          void (*walkBlock)(const int[], int, Red &, const Phase &)>
+void walk_Bag(Bag<int> &b, Red &next, const Phase &ph) {
+  if (b.getFill() > 0) {
+    // Split the bag and recurse
+    Pennant<int> *p = NULL;
+
+    b.split(&p); // Destructive split, decrements b.getFill()
+    cilk_spawn walk_Pennant<Red, Phase, walkBlock>(p, next, ph);
+    walk_Bag<Red, Phase, walkBlock>(b, next, ph);
+  } else {
+#if FILLING_LIST
+    // Walk the partially-filled blocks merge() left in place
+    for (uint32_t k = 0; k < b.getNumPartials(); ++k)
+      cilk_spawn walkBlock(b.getPartial(k), b.getPartialSize(k), next, ph);
+#endif // FILLING_LIST
+    walkBlock(b.getFilling(), b.getFillingSize(), next, ph);
+  }
+}
+
+#endif // BAGWALK_H
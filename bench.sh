@@ -0,0 +1,112 @@
+#!/bin/sh
+# Regression benchmark over the bundled graphs.  Each graph is cached
+# once as a CSR file, which bfs maps instead of decompressing the graph
+# again.  Each algorithm is then run from each source, with its result
+# checked, and a line with its load time, fastest time and TEPS (edges
+# traversed per second) is written to the results file.  Given a
+# baseline from an earlier run, the times are compared against it, and
+# slowdowns beyond the threshold are reported.
+#
+# Usage: bench.sh [-o <results>] [-b <baseline>] [-t <percent>]
+#
+# The environment variables BFS, BENCH_GRAPHS, BENCH_ALGS, BENCH_SOURCES
+# and BENCH_CACHE override the defaults below.
+
+BFS=${BFS:-./bfs}
+GRAPHS=${BENCH_GRAPHS:-$(ls graphs/*.bin graphs/*.bin.bz2 2>/dev/null)}
+ALGS=${BENCH_ALGS:-b p w c d e}
+SOURCES=${BENCH_SOURCES:-0}
+CACHE=${BENCH_CACHE:-bench-cache}
+RESULTS=bench-results.csv
+BASELINE=
+THRESHOLD=10
+
+usage() {
+  echo "Usage: $0 [-o <results>] [-b <baseline>] [-t <percent>]" >&2
+  exit 1
+}
+
+while getopts o:b:t: opt; do
+  case $opt in
+  o) RESULTS=$OPTARG ;;
+  b) BASELINE=$OPTARG ;;
+  t) THRESHOLD=$OPTARG ;;
+  *) usage ;;
+  esac
+done
+[ $OPTIND -gt $# ] || usage
+
+mkdir -p "$CACHE" || exit 1
+echo "graph,algorithm,source,load_seconds,seconds,edges,teps,check" \
+  > "$RESULTS" || exit 1
+
+status=0
+for graph in $GRAPHS; do
+  name=$(basename "$graph")
+  name=${name%.bz2}
+  name=${name%.bin}
+  csr=$CACHE/$name.csr
+  if [ ! -s "$csr" ] || [ "$graph" -nt "$csr" ]; then
+    echo "Caching $graph as $csr" >&2
+    if ! "$BFS" -f "$graph" -n 0 -o "$csr" > /dev/null; then
+      # The bundled graphs are Git LFS objects; run git lfs pull first
+      echo "Skipping $graph, which bfs cannot read" >&2
+      rm -f "$csr"
+      continue
+    fi
+  fi
+
+  for alg in $ALGS; do
+    for source in $SOURCES; do
+      if ! line=$("$BFS" -f "$csr" -a "$alg" -s "$source" -c -r) ||
+        [ -z "$line" ]; then
+        echo "bfs -a $alg -s $source failed on $name" >&2
+        status=1
+        continue
+      fi
+      echo "$line" | awk -F, -v g="$name" -v a="$alg" -v s="$source" '{
+        printf "%s,%s,%s,%s,%s,%s,%.0f,%s\n", g, a, s, $6, $1, $5,
+               ($1 > 0 ? $5 / $1 : 0), ($7 == 0 ? "ok" : "FAILED")
+      }' >> "$RESULTS"
+    done
+  done
+done
+
+# Print the results as a table, and fail if any check failed
+awk -F, 'NR == 1 {
+  printf "%-28s %-4s %8s %10s %10s %14s %s\n", "graph", "alg", "source",
+         "load (s)", "time (s)", "TEPS", "check"
+  next
+}
+{
+  printf "%-28s %-4s %8s %10.4f %10.6f %14.0f %s\n", $1, $2, $3, $4, $5, $7,
+         $8
+  if ($8 != "ok")
+    failed = 1
+}
+END { exit failed }' "$RESULTS" || status=1
+
+if [ -n "$BASELINE" ]; then
+  # Compare each time with the baseline's for the same graph, algorithm
+  # and source
+  awk -F, -v t="$THRESHOLD" 'FNR == 1 { next }
+  NR == FNR { base[$1 "," $2 "," $3] = $5; next }
+  {
+    key = $1 "," $2 "," $3
+    if (!(key in base) || base[key] <= 0)
+      next
+    change = 100 * ($5 - base[key]) / base[key]
+    if (change > t) {
+      printf "Slower: %s -a %s -s %s, %f -> %f seconds (+%.1f%%)\n", $1, $2,
+             $3, base[key], $5, change
+      slower = 1
+    }
+  }
+  END {
+    if (!slower)
+      printf "No slowdowns above %s%%\n", t
+    exit slower
+  }' "$BASELINE" "$RESULTS" || status=1
+fi
+
+exit $status
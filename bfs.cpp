@@ -21,28 +21,62 @@
  * SOFTWARE.
  */
 
-#include "graph.h"
+#include "pbfs.h"
+#include "perfcounters.h"
 #include "util.h"
+#include <algorithm>
 #include <cilk/cilk.h>
+#include <cilk/cilk_api.h>
 #include <cilk/cilkscale.h>
+#include <cmath>
 #include <cstdio>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
 
 using namespace std;
 
 const bool DEBUG = false;
-const int TRIALS = 10;
+
+// Least i at which a[i] and b[i] differ, or n if none, found in parallel
+template <typename T>
+static int first_mismatch(const T a[], const T b[], int n) {
+  int first = n;
+  cilk_for(int i = 0; i < n; ++i) {
+    if (a[i] != b[i]) {
+      int cur = __atomic_load_n(&first, __ATOMIC_RELAXED);
+      while (i < cur && !__atomic_compare_exchange_n(&first, &cur, i, false,
+                                                     __ATOMIC_RELAXED,
+                                                     __ATOMIC_RELAXED))
+        ;
+    }
+  }
+  return first;
+}
 
 // Helper function for checking correctness of result
-static bool check(unsigned int distances[], unsigned int distverf[],
+static bool check(const unsigned int distances[], unsigned int distverf[],
                   int nodes) {
-  for (int i = 0; i < nodes; i++) {
-    if (distances[i] != distverf[i]) {
-      fprintf(stderr, "distances[%d] = %d; distverf[%d] = %d\n", i,
-              distances[i], i, distverf[i]);
-      return false;
-    }
+  int i = first_mismatch(distances, (const unsigned int *)distverf, nodes);
+  if (i < nodes) {
+    fprintf(stderr, "distances[%d] = %d; distverf[%d] = %d\n", i,
+            distances[i], i, distverf[i]);
+    return false;
+  }
+
+  return true;
+}
+
+// Helper function for checking correctness of a weighted result
+static bool check(double distances[], double distverf[], int nodes) {
+  int i = first_mismatch((const double *)distances, (const double *)distverf,
+                         nodes);
+  if (i < nodes) {
+    fprintf(stderr, "distances[%d] = %g; distverf[%d] = %g\n", i,
+            distances[i], i, distverf[i]);
+    return false;
   }
 
   return true;
@@ -52,32 +86,270 @@ unsigned long long todval(struct timeval *tp) {
   return tp->tv_sec * 1000 * 1000 + tp->tv_usec;
 }
 
+// Print the events counted between before and after
+static void print_counts(const unsigned long long before[],
+                         const unsigned long long after[]) {
+  for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+    printf("%s%s ", e > 0 ? ", " : "", PERF_EVENT_NAMES[e]);
+    if (before[e] == PERF_UNAVAILABLE || after[e] == PERF_UNAVAILABLE)
+      printf("n/a");
+    else
+      printf("%llu", after[e] - before[e]);
+  }
+}
+
+// Counters read at the start of each layer, through Graph's layer hook
+typedef struct {
+  unsigned int depth;
+  size_t frontierSize;
+  unsigned long long values[PERF_NUM_EVENTS];
+} LayerCounts;
+
+typedef struct {
+  PerfCounters *counters;
+  vector<LayerCounts> layers;
+} LayerLog;
+
+static void log_layer(void *arg, unsigned int depth, size_t frontierSize) {
+  LayerLog *log = (LayerLog *)arg;
+  LayerCounts layer;
+  layer.depth = depth;
+  layer.frontierSize = frontierSize;
+  log->counters->read(layer.values);
+  log->layers.push_back(layer);
+}
+
+// Edges of the nodes that a search reached, each of which a top-down
+// search scans once
+static unsigned long long edges_traversed(const Graph *graph,
+                                          const unsigned int distances[]) {
+  unsigned long long edges = 0;
+  for (unsigned int u = 0; u < graph->numNodes(); ++u)
+    if (distances[u] != UINT_MAX)
+      edges += graph->getNodes()[u + 1] - graph->getNodes()[u];
+  return edges;
+}
+
+// Edges of the nodes that a weighted search reached
+static unsigned long long edges_traversed(const Graph *graph,
+                                          const double distances[]) {
+  unsigned long long edges = 0;
+  for (unsigned int u = 0; u < graph->numNodes(); ++u)
+    if (distances[u] != INFINITY)
+      edges += graph->getNodes()[u + 1] - graph->getNodes()[u];
+  return edges;
+}
+
+// The line that -r prints
+typedef struct {
+  double seconds;
+  long long work;
+  long long span;
+  long long bspan;
+} TrialReport;
+
+// Run program with args and CILK_NWORKERS set to workers, and read the
+// line that its -r flag prints
+static int run_report(const char *program, vector<char *> args, int workers,
+                      TrialReport *report) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    perror("pipe");
+    return -1;
+  }
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    close(fds[0]);
+    close(fds[1]);
+    return -1;
+  }
+  if (pid == 0) {
+    dup2(fds[1], STDOUT_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+    setenv("CILK_NWORKERS", to_string(workers).c_str(), 1);
+    args[0] = const_cast<char *>(program);
+    execvp(program, args.data());
+    fprintf(stderr, "Cannot run %s\n", program);
+    _exit(127);
+  }
+  close(fds[1]);
+
+  FILE *in = fdopen(fds[0], "r");
+  int found = fscanf(in, "%lf,%lld,%lld,%lld", &report->seconds,
+                     &report->work, &report->span, &report->bspan);
+  fclose(in);
+  int status;
+  waitpid(pid, &status, 0);
+  if (found != 4 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "%s failed on %d workers\n", program, workers);
+    return -1;
+  }
+  return 0;
+}
+
+// Scalability mode: time this program on 1 to P workers, take the work,
+// span and burdened span from one run of its Cilkscale build, and print
+// the speedups beside the parallelism as CSV.  A speedup that falls well
+// short of the burdened parallelism points to memory bandwidth rather
+// than to the span.
+static int scale_report(int argc, char *argv[], const BFSArgs &bfsArgs) {
+  vector<char *> args;
+  args.push_back(argv[0]);
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-P") == 0 || strcmp(argv[i], "-W") == 0)
+      ++i;
+    else
+      args.push_back(argv[i]);
+  }
+  args.push_back(const_cast<char *>("-r"));
+  args.push_back(NULL);
+
+  string cilkscale = bfsArgs.cilkscale_program.empty()
+                         ? string(argv[0]) + "-cilkscale"
+                         : bfsArgs.cilkscale_program;
+  TrialReport wsp;
+  bool haveWsp = run_report(cilkscale.c_str(), args, 1, &wsp) == 0;
+  if (haveWsp && (wsp.span <= 0 || wsp.bspan <= 0)) {
+    fprintf(stderr, "%s is not built with Cilkscale\n", cilkscale.c_str());
+    haveWsp = false;
+  }
+  if (!haveWsp)
+    fprintf(stderr, "Leaving out the parallelism\n");
+
+  printf("workers,seconds,speedup,parallelism,burdened_parallelism,"
+         "predicted_speedup\n");
+  double serial = 0;
+  for (int p = 1; p <= bfsArgs.scale_workers; ++p) {
+    TrialReport r;
+    if (run_report("/proc/self/exe", args, p, &r) != 0)
+      return -1;
+    if (p == 1)
+      serial = r.seconds;
+    printf("%d,%f,%f", p, r.seconds, serial / r.seconds);
+    if (haveWsp) {
+      double parallelism = (double)wsp.work / wsp.span;
+      double burdened = (double)wsp.work / wsp.bspan;
+      printf(",%f,%f,%f", parallelism, burdened, min((double)p, burdened));
+    } else {
+      printf(",,,");
+    }
+    printf("\n");
+    fflush(stdout);
+  }
+  return 0;
+}
+
 int main(int argc, char **argv) {
   Graph *graph;
   unsigned long long runtime_ms;
 
   BFSArgs bfsArgs = parse_args(argc, argv);
+  if (bfsArgs.scale_workers > 0)
+    return scale_report(argc, argv, bfsArgs);
 
   if (DEBUG)
     printf("algorithm = %s\n", ALG_NAMES[bfsArgs.alg_select]);
 
-  if (parseBinaryFile(bfsArgs.filename, &graph) != 0)
+  struct timeval l1, l2;
+  gettimeofday(&l1, 0);
+  if (!bfsArgs.generator.empty()) {
+    if (generateGraph(bfsArgs.generator, &graph) != 0)
+      return -1;
+    bfsArgs.filename = bfsArgs.generator;
+  } else if (parseGraphFile(bfsArgs.filename, &graph,
+                            bfsArgs.alg_select == SSSP) != 0) {
+    return -1;
+  }
+  if (bfsArgs.symmetrize || bfsArgs.no_self_loops || bfsArgs.no_duplicates) {
+    SimplifyStats stats = graph->simplify(
+        bfsArgs.symmetrize, bfsArgs.no_self_loops, bfsArgs.no_duplicates);
+    if (!bfsArgs.report)
+      printf("Removed %u self loops and %u duplicate edges, added %u reverse "
+           "edges\n",
+           stats.selfLoops, stats.duplicates, stats.added);
+  }
+  gettimeofday(&l2, 0);
+  unsigned long long load_us = todval(&l2) - todval(&l1);
+  if (!bfsArgs.report)
+    printf("Loading %s: %f seconds\n", bfsArgs.filename.c_str(),
+           load_us / 1000000.0);
+  if (!bfsArgs.output.empty() && writeGraphFile(bfsArgs.output, graph) != 0)
     return -1;
 
   // Initialize extra data structures
   int numNodes = graph->numNodes();
   unsigned int *distances = new unsigned int[numNodes];
+  double *weightedDistances =
+      bfsArgs.alg_select == SSSP ? new double[numNodes] : NULL;
+  BFSWorkspace *ws =
+      bfsArgs.alg_select == PBFS_BOUNDED ? new BFSWorkspace(numNodes) : NULL;
+  BidirWorkspace *bidirWs =
+      bfsArgs.alg_select == PBFS_BIDIR ? new BidirWorkspace(numNodes) : NULL;
+  unsigned int distance;
+  vector<int> path;
 
-  // Pick a starting node
-  int s = 0;
+  if (bfsArgs.alg_select == PBFS_DO || bfsArgs.alg_select == PBFS_BIDIR)
+    graph->indexParents();
+
+  // The starting node, and a target for PBFS_BIDIR
+  int s = bfsArgs.source;
+  if (s < 0 || s >= numNodes) {
+    fprintf(stderr, "Source %d is not a node\n", s);
+    return -1;
+  }
+  int target = bfsArgs.target >= 0 ? bfsArgs.target : numNodes - 1;
+  if (bfsArgs.alg_select == PBFS_BIDIR && target >= numNodes) {
+    fprintf(stderr, "Target %d is not a node\n", target);
+    return -1;
+  }
+
+  // Hardware counters, read around each trial and, for PBFS and
+  // PBFS_BALANCED, each layer
+  PerfCounters *counters = NULL;
+  LayerLog layerLog;
+  if (bfsArgs.count_events) {
+    // The counters attach only to threads that exist, and loading a .csr
+    // file runs no parallel code, so start the Cilk workers first.
+    int nworkers = __cilkrts_get_nworkers();
+    cilk_for(int i = 0; i < nworkers; ++i) {
+      volatile int spin = 0;
+      while (spin < 1000)
+        spin = spin + 1;
+    }
+    counters = new PerfCounters();
+    if (counters->open() != 0) {
+      fprintf(stderr, "Hardware counters are unavailable; not counting\n");
+      delete counters;
+      counters = NULL;
+    } else {
+      layerLog.counters = counters;
+      graph->setLayerHook(log_layer, &layerLog);
+    }
+  }
+  unsigned long long before[PERF_NUM_EVENTS], after[PERF_NUM_EVENTS];
+
+  unsigned long long best_us = 0;
+  wsp_t best_wsp;
+  int errors = 0;
+  // Reference results for -c, computed in the first trial that needs
+  // them
+  unsigned int *reference = NULL;
+  double *weightedReference = NULL;
 
   // Execute BFS
-  for (int t = 0; t < TRIALS; ++t) {
+  for (int t = 0; t < bfsArgs.trials; ++t) {
     struct timeval t1, t2;
     wsp_t wsp1, wsp2;
     // cilk_for (int i = 0; i < numNodes; ++i) {
     //   distances[i] = UINT_MAX;
     // }
+    if (counters != NULL) {
+      layerLog.layers.clear();
+      counters->read(before);
+    }
     switch (bfsArgs.alg_select) {
     case BFS:
       wsp1 = wsp_getworkspan();
@@ -93,30 +365,145 @@ int main(int argc, char **argv) {
       gettimeofday(&t2, 0);
       wsp2 = wsp_getworkspan();
       break;
-    // case PBFS_WLS:
-    //   gettimeofday(&t1,0);
-    //   graph->pbfs_wls(s, distances);
-    //   gettimeofday(&t2,0);
-    //   break;
+    case PBFS_WLS:
+      wsp1 = wsp_getworkspan();
+      gettimeofday(&t1, 0);
+      graph->pbfs_wls(s, distances);
+      gettimeofday(&t2, 0);
+      wsp2 = wsp_getworkspan();
+      break;
+    case PBFS_COMPACT:
+      wsp1 = wsp_getworkspan();
+      gettimeofday(&t1, 0);
+      graph->pbfs_compact(s, distances);
+      gettimeofday(&t2, 0);
+      wsp2 = wsp_getworkspan();
+      break;
+    case PBFS_DO:
+      wsp1 = wsp_getworkspan();
+      gettimeofday(&t1, 0);
+      graph->pbfs_do(s, distances);
+      gettimeofday(&t2, 0);
+      wsp2 = wsp_getworkspan();
+      break;
+    case PBFS_BALANCED:
+      wsp1 = wsp_getworkspan();
+      gettimeofday(&t1, 0);
+      graph->pbfs_balanced(s, distances);
+      gettimeofday(&t2, 0);
+      wsp2 = wsp_getworkspan();
+      break;
+    case SSSP:
+      wsp1 = wsp_getworkspan();
+      gettimeofday(&t1, 0);
+      if (graph->sssp(s, weightedDistances, bfsArgs.delta) != 0)
+        return -1;
+      gettimeofday(&t2, 0);
+      wsp2 = wsp_getworkspan();
+      break;
+    case PBFS_BOUNDED:
+      wsp1 = wsp_getworkspan();
+      gettimeofday(&t1, 0);
+      graph->pbfs_bounded(s, bfsArgs.max_depth, bfsArgs.max_visited, *ws);
+      gettimeofday(&t2, 0);
+      wsp2 = wsp_getworkspan();
+      break;
+    case PBFS_BIDIR:
+      wsp1 = wsp_getworkspan();
+      gettimeofday(&t1, 0);
+      graph->pbfs_bidir(s, target, &distance, &path, *bidirWs);
+      gettimeofday(&t2, 0);
+      wsp2 = wsp_getworkspan();
+      break;
     default:
       break;
     }
+    if (counters != NULL)
+      counters->read(after);
 
     runtime_ms = (todval(&t2) - todval(&t1)) / 1000;
+    // Keep the fastest trial for -r
+    if (t == 0 || todval(&t2) - todval(&t1) < best_us) {
+      best_us = todval(&t2) - todval(&t1);
+      best_wsp = wsp2 - wsp1;
+    }
 
     // Verify correctness
-    if (bfsArgs.check_correctness) {
+    if (bfsArgs.check_correctness && bfsArgs.alg_select == SSSP) {
+
+      if (weightedReference == NULL) {
+        weightedReference = new double[numNodes];
+        graph->dijkstra(s, weightedReference);
+      }
+      if (!check(weightedDistances, weightedReference, numNodes)) {
+        fprintf(stderr, "Error found in %s result.\n",
+                ALG_NAMES[bfsArgs.alg_select]);
+        ++errors;
+      }
+    } else if (bfsArgs.check_correctness &&
+               bfsArgs.alg_select == PBFS_BOUNDED) {
 
+      if (reference == NULL) {
+        reference = new unsigned int[numNodes];
+        graph->bfs(s, reference);
+      }
       unsigned int *distverf = new unsigned int[numNodes];
-      // cilk_for (int i = 0; i < numNodes; ++i) {
-      //   distverf[i] = UINT_MAX;
-      // }
-      graph->bfs(s, distverf);
-      if (!check(distances, distverf, numNodes))
+      cilk_for(int i = 0; i < numNodes; ++i) distverf[i] = reference[i];
+      // Only the nodes within the bound are visited.  A capped search
+      // visits only part of its last layer.
+      const unsigned int *bounded = ws->getDistances();
+      const vector<int> &visited = ws->getVisited();
+      if (visited.empty()) {
+        // Nothing visited, as with -m 0, leaves every entry at UINT_MAX.
+        cilk_for(int i = 0; i < numNodes; ++i) distverf[i] = UINT_MAX;
+      } else {
+        unsigned int last = bounded[visited.back()];
+        bool capped = visited.size() == bfsArgs.max_visited;
+        cilk_for(int i = 0; i < numNodes; ++i) {
+          if (distverf[i] > bfsArgs.max_depth ||
+              (capped && distverf[i] >= last && bounded[i] == UINT_MAX))
+            distverf[i] = UINT_MAX;
+        }
+      }
+      if (!check(bounded, distverf, numNodes)) {
         fprintf(stderr, "Error found in %s result.\n",
                 ALG_NAMES[bfsArgs.alg_select]);
+        ++errors;
+      }
 
       delete[] distverf;
+    } else if (bfsArgs.check_correctness &&
+               bfsArgs.alg_select == PBFS_BIDIR) {
+
+      if (reference == NULL) {
+        reference = new unsigned int[numNodes];
+        graph->bfs(s, reference);
+      }
+      // The path must be made of distance edges from s to target
+      bool ok = distance == reference[target];
+      if (ok && distance != UINT_MAX) {
+        ok = path.size() == distance + 1 && path.front() == s &&
+             path.back() == target;
+        for (size_t i = 0; ok && i + 1 < path.size(); ++i)
+          ok = graph->hasEdge(path[i], path[i + 1]);
+      }
+      if (!ok) {
+        fprintf(stderr, "Error found in %s result.\n",
+                ALG_NAMES[bfsArgs.alg_select]);
+        ++errors;
+      }
+    } else if (bfsArgs.check_correctness) {
+
+      // Check the BFS invariants in parallel, rather than rerunning a
+      // serial BFS
+      int bad;
+      if (graph->verify(s, distances, &bad) != 0) {
+        fprintf(stderr, "distances[%d] = %d breaks the BFS invariants\n",
+                bad, distances[bad]);
+        fprintf(stderr, "Error found in %s result.\n",
+                ALG_NAMES[bfsArgs.alg_select]);
+        ++errors;
+      }
     }
 
     // Print results if debugging
@@ -125,6 +512,9 @@ int main(int argc, char **argv) {
         printf("Distance to node %d: %d\n", i + 1, distances[i]);
     }
 
+    if (bfsArgs.report)
+      continue;
+
     // Print runtime result
     switch (bfsArgs.alg_select) {
     case BFS:
@@ -135,17 +525,93 @@ int main(int argc, char **argv) {
       printf("PBFS on %s: %f seconds\n", bfsArgs.filename.c_str(),
              runtime_ms / 1000.0);
       break;
-    // case PBFS_WLS:
-    //   printf("PBFS_WLS on %s: %f seconds\n", bfsArgs.filename.c_str(),
-    //   runtime_ms/1000.0); break;
+    case PBFS_WLS:
+      printf("PBFS_WLS on %s: %f seconds\n", bfsArgs.filename.c_str(),
+             runtime_ms / 1000.0);
+      break;
+    case PBFS_COMPACT:
+      printf("PBFS_COMPACT on %s: %f seconds\n", bfsArgs.filename.c_str(),
+             runtime_ms / 1000.0);
+      break;
+    case PBFS_DO:
+      printf("PBFS_DO on %s: %f seconds\n", bfsArgs.filename.c_str(),
+             runtime_ms / 1000.0);
+      break;
+    case PBFS_BALANCED:
+      printf("PBFS_BALANCED on %s: %f seconds\n", bfsArgs.filename.c_str(),
+             runtime_ms / 1000.0);
+      break;
+    case SSSP:
+      printf("SSSP on %s: %f seconds\n", bfsArgs.filename.c_str(),
+             runtime_ms / 1000.0);
+      break;
+    case PBFS_BOUNDED:
+      printf("PBFS_BOUNDED on %s: %f seconds, %zu nodes visited\n",
+             bfsArgs.filename.c_str(), runtime_ms / 1000.0,
+             ws->getVisited().size());
+      break;
+    case PBFS_BIDIR:
+      printf("PBFS_BIDIR on %s: %f seconds, distance %d\n",
+             bfsArgs.filename.c_str(), runtime_ms / 1000.0,
+             distance == UINT_MAX ? -1 : (int)distance);
+      break;
     default:
       break;
     }
 
+    if (counters != NULL) {
+      printf("Counters: ");
+      print_counts(before, after);
+      printf("\n");
+      // Bandwidth is estimated as a cache line per LLC load miss
+      bool topDown = bfsArgs.alg_select != SSSP &&
+                     bfsArgs.alg_select != PBFS_BOUNDED &&
+                     bfsArgs.alg_select != PBFS_BIDIR;
+      unsigned long long edges =
+          topDown ? edges_traversed(graph, distances) : 0;
+      if (topDown && before[PERF_LLC_MISSES] != PERF_UNAVAILABLE) {
+        double bytes =
+            64.0 * (after[PERF_LLC_MISSES] - before[PERF_LLC_MISSES]);
+        printf("Memory traffic: %llu edges, %f bytes per edge, %f GB/s\n",
+               edges, edges > 0 ? bytes / edges : 0.0,
+               bytes / (todval(&t2) - todval(&t1)) / 1000.0);
+      }
+      if (topDown && before[PERF_BRANCH_MISSES] != PERF_UNAVAILABLE) {
+        double misses = after[PERF_BRANCH_MISSES] - before[PERF_BRANCH_MISSES];
+        printf("Branch misses: %f per edge\n",
+               edges > 0 ? misses / edges : 0.0);
+      }
+      for (size_t i = 0; i + 1 < layerLog.layers.size(); ++i) {
+        const LayerCounts &layer = layerLog.layers[i];
+        printf("  Layer %u, %zu nodes: ", layer.depth, layer.frontierSize);
+        print_counts(layer.values, layerLog.layers[i + 1].values);
+        printf("\n");
+      }
+    }
+
     wsp_dump(wsp2 - wsp1, "alg");
   }
 
+  if (bfsArgs.report) {
+    unsigned long long edges = 0;
+    if (bfsArgs.alg_select == SSSP)
+      edges = edges_traversed(graph, weightedDistances);
+    else if (bfsArgs.alg_select == PBFS_BOUNDED)
+      edges = edges_traversed(graph, ws->getDistances());
+    else if (bfsArgs.alg_select != PBFS_BIDIR)
+      edges = edges_traversed(graph, distances);
+    printf("%f,%lld,%lld,%lld,%llu,%f,%d\n", best_us / 1000000.0,
+           (long long)best_wsp.work, (long long)best_wsp.span,
+           (long long)best_wsp.bspan, edges, load_us / 1000000.0, errors);
+  }
+
   delete[] distances;
+  delete[] weightedDistances;
+  delete[] reference;
+  delete[] weightedReference;
+  delete ws;
+  delete bidirWs;
+  delete counters;
   delete graph;
 
   return 0;
@@ -0,0 +1,494 @@
+// Copyright (c) 2010-2024, Tao B. Schardl
+/*
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Query server: loads graphs once, and then answers BFS queries, one
+// per line, from stdin or from clients of a Unix domain socket.  The
+// BFS queries that arrive together for the same graph are answered by
+// multi-source searches.
+
+#include "pbfs.h"
+#include "util.h"
+#include <algorithm>
+#include <cerrno>
+#include <cilk/cilk.h>
+#include <climits>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+// Bytes read from a client at a time
+const int READ_SIZE = 1 << 16;
+// A client's queries are not read while more than this many bytes of
+// its responses wait to be written
+const size_t MAX_PENDING = 1 << 22;
+
+// Structure defining command line argument values
+typedef struct {
+  vector<string> filenames;
+  string socket;
+  bool symmetrize;
+  bool no_self_loops;
+  bool no_duplicates;
+} ServerArgs;
+
+// What a response reports about the nodes a query reaches
+enum OUTPUT_KIND { OUTPUT_COUNT = 0, OUTPUT_LEVELS = 1, OUTPUT_DIST = 2 };
+
+static const char *OUTPUT_NAMES[] = {"count", "levels", "dist"};
+
+// A loaded graph, with the state that its queries reuse
+typedef struct {
+  Graph *graph;
+  unsigned int *distances;
+  BFSWorkspace *bounded;
+  MSBFSWorkspace *multi;
+} ServedGraph;
+
+// A socket connection, or stdin and stdout.  A socket is non-blocking,
+// so that a client that does not read its responses cannot stall the
+// others; stdout is left blocking, since it may be shared.
+typedef struct {
+  int in;
+  int out;
+  // Input not yet split into lines
+  string buffer;
+  // Responses not yet written
+  string output;
+  // Set at the end of the input, or when a write fails
+  bool eof;
+  bool closed;
+} Client;
+
+typedef struct {
+  Client *client;
+  int graph;
+  int source;
+  ALG_SELECT alg;
+  unsigned int depth;
+  OUTPUT_KIND output;
+  // Set if the query is malformed
+  string error;
+} Query;
+
+static void print_server_usage(char *argv0) {
+  fprintf(stderr,
+          "Usage: %s -f <filename> [-f <filename> ...] [-s <socket>] [-S] "
+          "[-L] [-U]\n",
+          argv0);
+  fprintf(stderr, "Flags are:\n");
+  fprintf(stderr, "\t-f <filename>\t: Load a graph; graphs are numbered from "
+                  "0 in the order given.\n");
+  fprintf(stderr, "\t-s <socket>\t: Serve clients of this Unix domain socket "
+                  "instead of stdin.\n");
+  fprintf(stderr, "\t-S\t\t: Add the reverse of each edge that has none.\n");
+  fprintf(stderr, "\t-L\t\t: Remove self loops.\n");
+  fprintf(stderr, "\t-U\t\t: Remove duplicate edges.\n");
+  exit(1);
+}
+
+static ServerArgs parse_server_args(int argc, char *argv[]) {
+  ServerArgs theArgs;
+  theArgs.socket = "";
+  theArgs.symmetrize = false;
+  theArgs.no_self_loops = false;
+  theArgs.no_duplicates = false;
+
+  for (int arg_i = 1; arg_i < argc; ++arg_i) {
+    char *arg = argv[arg_i];
+
+    if (strcmp(arg, "-f") == 0 && arg_i + 1 < argc) {
+      theArgs.filenames.push_back(argv[++arg_i]);
+    } else if (strcmp(arg, "-s") == 0 && arg_i + 1 < argc) {
+      theArgs.socket = argv[++arg_i];
+    } else if (strcmp(arg, "-S") == 0) {
+      theArgs.symmetrize = true;
+    } else if (strcmp(arg, "-L") == 0) {
+      theArgs.no_self_loops = true;
+    } else if (strcmp(arg, "-U") == 0) {
+      theArgs.no_duplicates = true;
+    } else {
+      print_server_usage(argv[0]);
+    }
+  }
+  if (theArgs.filenames.empty())
+    print_server_usage(argv[0]);
+
+  return theArgs;
+}
+
+// Parse "<graph> <source> [<algorithm> [<depth> [<output>]]]", where a
+// depth of "-" is unlimited
+static Query parse_query(Client *client, const char *line,
+                         const vector<ServedGraph> &graphs) {
+  Query q;
+  q.client = client;
+  q.alg = DEFAULT_ALG_SELECT;
+  q.depth = UINT_MAX;
+  q.output = OUTPUT_COUNT;
+
+  char alg[16] = "", depth[16] = "-", output[16] = "";
+  int n = sscanf(line, "%d %d %15s %15s %15s", &q.graph, &q.source, alg, depth,
+                 output);
+  if (n < 2) {
+    q.error = "expected <graph> <source> [<algorithm> [<depth> [<output>]]]";
+    return q;
+  }
+  if (q.graph < 0 || q.graph >= graphs.size()) {
+    q.error = "no such graph";
+    return q;
+  }
+  if (q.source < 0 || q.source >= graphs[q.graph].graph->numNodes()) {
+    q.error = "no such source";
+    return q;
+  }
+  if (n >= 3) {
+    int i;
+    for (i = 0; i < NULL_ALG; ++i)
+      if (strcmp(alg, ALG_ABBR[i]) == 0)
+        break;
+    if (i == NULL_ALG || i == SSSP || i == PBFS_BIDIR) {
+      q.error = "unsupported algorithm";
+      return q;
+    }
+    q.alg = (ALG_SELECT)i;
+  }
+  if (strcmp(depth, "-") != 0) {
+    char *end;
+    q.depth = strtoul(depth, &end, 10);
+    if (*end != '\0' || depth[0] == '-') {
+      q.error = "bad depth";
+      return q;
+    }
+  }
+  if (n >= 5) {
+    int i;
+    for (i = 0; i <= OUTPUT_DIST; ++i)
+      if (strcmp(output, OUTPUT_NAMES[i]) == 0)
+        break;
+    if (i > OUTPUT_DIST) {
+      q.error = "unknown output";
+      return q;
+    }
+    q.output = (OUTPUT_KIND)i;
+  }
+
+  return q;
+}
+
+// Format the response to q, given the nodes it reached and their
+// distances
+static void respond(const Query &q,
+                    const vector<pair<int, unsigned int>> &reached,
+                    string &out) {
+  unsigned int maxDist = 0;
+  for (size_t i = 0; i < reached.size(); ++i)
+    maxDist = max(maxDist, reached[i].second);
+
+  char buf[64];
+  snprintf(buf, sizeof(buf), "ok %d %d %zu %u\n", q.graph, q.source,
+           reached.size(), maxDist);
+  out += buf;
+  if (q.output == OUTPUT_LEVELS) {
+    vector<long> levels(maxDist + 1, 0);
+    for (size_t i = 0; i < reached.size(); ++i)
+      ++levels[reached[i].second];
+    for (unsigned int d = 0; d <= maxDist; ++d) {
+      snprintf(buf, sizeof(buf), d == 0 ? "%ld" : " %ld", levels[d]);
+      out += buf;
+    }
+    out += "\n";
+  } else if (q.output == OUTPUT_DIST) {
+    for (size_t i = 0; i < reached.size(); ++i) {
+      snprintf(buf, sizeof(buf), "%d %u\n", reached[i].first,
+               reached[i].second);
+      out += buf;
+    }
+  }
+}
+
+// Answer q alone, with the algorithm it asks for
+static void answer_single(const Query &q, ServedGraph &sg,
+                          vector<pair<int, unsigned int>> &reached) {
+  const Graph *graph = sg.graph;
+  if (q.alg == PBFS_BOUNDED) {
+    graph->pbfs_bounded(q.source, q.depth, UINT_MAX, *sg.bounded);
+    const vector<int> &visited = sg.bounded->getVisited();
+    const unsigned int *distances = sg.bounded->getDistances();
+    for (size_t i = 0; i < visited.size(); ++i)
+      reached.push_back(make_pair(visited[i], distances[visited[i]]));
+    return;
+  }
+
+  switch (q.alg) {
+  case BFS:
+    graph->bfs(q.source, sg.distances);
+    break;
+  case PBFS_WLS:
+    graph->pbfs_wls(q.source, sg.distances);
+    break;
+  case PBFS_COMPACT:
+    graph->pbfs_compact(q.source, sg.distances);
+    break;
+  case PBFS_DO:
+    graph->pbfs_do(q.source, sg.distances);
+    break;
+  case PBFS_BALANCED:
+    graph->pbfs_balanced(q.source, sg.distances);
+    break;
+  default:
+    graph->pbfs(q.source, sg.distances);
+    break;
+  }
+  for (int v = 0; v < graph->numNodes(); ++v)
+    if (sg.distances[v] != UINT_MAX && sg.distances[v] <= q.depth)
+      reached.push_back(make_pair(v, sg.distances[v]));
+}
+
+// Answer the queries batch[0..count) of one graph by a single
+// multi-source search, to the greatest depth any of them asks for
+static void answer_multi(const vector<Query> &queries, const int batch[],
+                         int count, ServedGraph &sg, vector<string> &out) {
+  int sources[MSBFS_MAX_SOURCES];
+  unsigned int maxDepth = 0;
+  for (int i = 0; i < count; ++i) {
+    sources[i] = queries[batch[i]].source;
+    maxDepth = max(maxDepth, queries[batch[i]].depth);
+  }
+  sg.graph->msbfs(sources, count, maxDepth, *sg.multi);
+
+  const vector<int> &nodes = sg.multi->getReached();
+  const vector<unsigned long long> &masks = sg.multi->getMasks();
+  const vector<size_t> &layers = sg.multi->getLayers();
+  vector<pair<int, unsigned int>> reached;
+  for (int i = 0; i < count; ++i) {
+    const Query &q = queries[batch[i]];
+    reached.clear();
+    for (unsigned int d = 0; d + 1 < layers.size() && d <= q.depth; ++d)
+      for (size_t j = layers[d]; j < layers[d + 1]; ++j)
+        if (masks[j] & (1ULL << i))
+          reached.push_back(make_pair(nodes[j], d));
+    respond(q, reached, out[batch[i]]);
+  }
+}
+
+// Answer a batch of queries, in the order given for each client
+static void answer(const vector<Query> &queries, vector<ServedGraph> &graphs) {
+  vector<string> out(queries.size());
+
+  for (int g = 0; g < graphs.size(); ++g) {
+    vector<int> batch;
+    for (size_t k = 0; k < queries.size(); ++k)
+      if (queries[k].error.empty() && queries[k].graph == g)
+        batch.push_back(k);
+
+    if (batch.size() == 1) {
+      vector<pair<int, unsigned int>> reached;
+      answer_single(queries[batch[0]], graphs[g], reached);
+      respond(queries[batch[0]], reached, out[batch[0]]);
+    } else {
+      for (size_t k = 0; k < batch.size(); k += MSBFS_MAX_SOURCES)
+        answer_multi(queries, batch.data() + k,
+                     min(batch.size() - k, (size_t)MSBFS_MAX_SOURCES),
+                     graphs[g], out);
+    }
+  }
+
+  for (size_t k = 0; k < queries.size(); ++k) {
+    Client *c = queries[k].client;
+    if (!queries[k].error.empty())
+      out[k] = "error " + queries[k].error + "\n";
+    if (!c->closed)
+      c->output += out[k];
+  }
+}
+
+// Write as much of client c's pending output as it will take now
+static void flush_output(Client *c) {
+  size_t done = 0;
+  while (!c->closed && done < c->output.size()) {
+    ssize_t n = write(c->out, c->output.data() + done,
+                      c->output.size() - done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+    if (n <= 0)
+      c->closed = true;
+    else
+      done += n;
+  }
+  c->output.erase(0, done);
+}
+
+// Read what client c has sent, and parse its complete lines into
+// queries
+static void read_queries(Client *c, const vector<ServedGraph> &graphs,
+                         vector<Query> &queries) {
+  char buf[READ_SIZE];
+  ssize_t n = read(c->in, buf, sizeof(buf));
+  if (n < 0 && errno == EINTR)
+    return;
+  if (n <= 0) {
+    // Answer a last line that has no newline
+    c->buffer += '\n';
+    c->eof = true;
+  } else {
+    c->buffer.append(buf, n);
+  }
+
+  size_t start = 0, end;
+  while ((end = c->buffer.find('\n', start)) != string::npos) {
+    string line = c->buffer.substr(start, end - start);
+    start = end + 1;
+    if (line.find_first_not_of(" \t\r") == string::npos || line[0] == '#')
+      continue;
+    queries.push_back(parse_query(c, line.c_str(), graphs));
+  }
+  c->buffer.erase(0, start);
+}
+
+int main(int argc, char **argv) {
+  ServerArgs args = parse_server_args(argc, argv);
+
+  vector<ServedGraph> graphs;
+  for (size_t g = 0; g < args.filenames.size(); ++g) {
+    ServedGraph sg;
+    if (parseGraphFile(args.filenames[g], &sg.graph) != 0)
+      return -1;
+    if (args.symmetrize || args.no_self_loops || args.no_duplicates)
+      sg.graph->simplify(args.symmetrize, args.no_self_loops,
+                         args.no_duplicates);
+    sg.graph->indexParents();
+    int n = sg.graph->numNodes();
+    sg.distances = new unsigned int[n];
+    sg.bounded = new BFSWorkspace(n);
+    sg.multi = new MSBFSWorkspace(n);
+    graphs.push_back(sg);
+    fprintf(stderr, "Graph %zu: %s, %d nodes, %u edges\n", g,
+            args.filenames[g].c_str(), n, sg.graph->numEdges());
+  }
+
+  // Report closed connections as write errors, rather than dying
+  signal(SIGPIPE, SIG_IGN);
+
+  int listener = -1;
+  vector<Client *> clients;
+  if (args.socket.empty()) {
+    clients.push_back(new Client{0, 1, "", "", false, false});
+  } else {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (args.socket.size() >= sizeof(addr.sun_path)) {
+      fprintf(stderr, "Socket path %s is too long\n", args.socket.c_str());
+      return -1;
+    }
+    strcpy(addr.sun_path, args.socket.c_str());
+    unlink(addr.sun_path);
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 ||
+        bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listener, SOMAXCONN) != 0) {
+      fprintf(stderr, "Unable to listen on %s: %s\n", args.socket.c_str(),
+              strerror(errno));
+      return -1;
+    }
+    fprintf(stderr, "Listening on %s\n", args.socket.c_str());
+  }
+
+  // Each round answers, as one batch, all the queries that have arrived
+  // since the last
+  vector<pollfd> fds;
+  vector<Query> queries;
+  while (listener >= 0 || !clients.empty()) {
+    fds.clear();
+    for (size_t i = 0; i < clients.size(); ++i) {
+      Client *c = clients[i];
+      short events = 0;
+      if (!c->eof && c->output.size() <= MAX_PENDING)
+        events |= POLLIN;
+      if (!c->output.empty())
+        events |= POLLOUT;
+      fds.push_back(pollfd{c->in, events, 0});
+    }
+    if (listener >= 0)
+      fds.push_back(pollfd{listener, POLLIN, 0});
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      fprintf(stderr, "poll: %s\n", strerror(errno));
+      break;
+    }
+
+    queries.clear();
+    for (size_t i = 0; i < clients.size(); ++i)
+      if (fds[i].revents & (POLLIN | POLLHUP | POLLERR) &&
+          (fds[i].events & POLLIN))
+        read_queries(clients[i], graphs, queries);
+    if (!queries.empty())
+      answer(queries, graphs);
+
+    // Write what each client will take without blocking; the rest waits
+    // for POLLOUT
+    for (size_t i = 0; i < clients.size(); ++i)
+      flush_output(clients[i]);
+
+    for (size_t i = 0; i < clients.size();) {
+      Client *c = clients[i];
+      if (c->closed || (c->eof && c->output.empty())) {
+        if (listener >= 0)
+          close(c->in);
+        delete c;
+        clients.erase(clients.begin() + i);
+      } else {
+        ++i;
+      }
+    }
+    if (listener >= 0 && (fds.back().revents & POLLIN)) {
+      int fd = accept(listener, NULL, NULL);
+      if (fd >= 0 && fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0) {
+        close(fd);
+        fd = -1;
+      }
+      if (fd >= 0)
+        clients.push_back(new Client{fd, fd, "", "", false, false});
+    }
+  }
+
+  for (size_t g = 0; g < graphs.size(); ++g) {
+    delete graphs[g].graph;
+    delete[] graphs[g].distances;
+    delete graphs[g].bounded;
+    delete graphs[g].multi;
+  }
+
+  return 0;
+}
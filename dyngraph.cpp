@@ -0,0 +1,361 @@
+// Copyright (c) 2010-2024, Tao B. Schardl
+/*
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Dynamic Graph Representation
+#include "dyngraph.h"
+#include "bag.h"
+#include "bagwalk.h"
+#include <algorithm>
+#include <cilk/cilk.h>
+#include <cilk/cilksan.h>
+#include <climits>
+#include <utility>
+
+// Fake lock to ignore known races on reading and writing distances[] array.
+static Cilksan_fake_mutex mtx;
+
+// The neighbor stored in a base entry, whether or not it is deleted
+static inline int base_neighbor(int e) { return e < 0 ? ~e : e; }
+
+DynGraph::DynGraph(const Graph &graph) {
+  this->nNodes = graph.numNodes();
+  this->nEdges = graph.numEdges();
+  this->nodes = new int[nNodes + 1];
+  this->edges = new int[nEdges];
+  this->overflow = new std::vector<int>[nNodes];
+  this->nDeleted = 0;
+  this->nOverflow = 0;
+
+  const int *gnodes = graph.getNodes(), *gedges = graph.getEdges();
+  cilk_for(int u = 0; u <= nNodes; ++u) nodes[u] = gnodes[u];
+  cilk_for(int i = 0; i < nEdges; ++i) edges[i] = gedges[i];
+}
+
+DynGraph::~DynGraph() {
+  delete[] this->nodes;
+  delete[] this->edges;
+  delete[] this->overflow;
+}
+
+// Position of v among u's base neighbors: a present copy if there is
+// one, otherwise a deleted copy, otherwise -1
+int DynGraph::findBase(int u, int v) const {
+  int *begin = edges + nodes[u], *end = edges + nodes[u + 1];
+  int *p = std::lower_bound(begin, end, v, [](int e, int v) {
+    return base_neighbor(e) < v;
+  });
+  int found = -1;
+  for (; p < end && base_neighbor(*p) == v; ++p) {
+    if (*p >= 0)
+      return p - edges;
+    found = p - edges;
+  }
+  return found;
+}
+
+bool DynGraph::hasEdge(int u, int v) const {
+  int i = findBase(u, v);
+  if (i >= 0 && edges[i] >= 0)
+    return true;
+  return std::find(overflow[u].begin(), overflow[u].end(), v) !=
+         overflow[u].end();
+}
+
+// Sort the edges of a batch by source, dropping repeats, and find where
+// each source's edges start, so that one strand applies all the edges
+// of a source.  Returns false if an edge has an invalid node.
+static bool sort_batch(const int src[], const int dst[], int count, int n,
+                       std::vector<std::pair<int, int>> &batch,
+                       std::vector<int> &starts) {
+  bool bad = false;
+  batch.resize(count);
+  cilk_for(int k = 0; k < count; ++k) {
+    if (src[k] < 0 || src[k] >= n || dst[k] < 0 || dst[k] >= n)
+      __atomic_store_n(&bad, true, __ATOMIC_RELAXED);
+    batch[k] = std::make_pair(src[k], dst[k]);
+  }
+  if (bad)
+    return false;
+
+  std::sort(batch.begin(), batch.end());
+  batch.erase(std::unique(batch.begin(), batch.end()), batch.end());
+  starts.clear();
+  for (size_t k = 0; k < batch.size(); ++k)
+    if (k == 0 || batch[k].first != batch[k - 1].first)
+      starts.push_back(k);
+  starts.push_back(batch.size());
+  return true;
+}
+
+int DynGraph::insertEdges(const int src[], const int dst[], int count) {
+  std::vector<std::pair<int, int>> batch;
+  std::vector<int> starts;
+  if (!sort_batch(src, dst, count, nNodes, batch, starts))
+    return -1;
+
+  // A deleted copy in the base is restored; otherwise the edge goes to
+  // its source's overflow block
+  unsigned int restored = 0, added = 0;
+  cilk_for(size_t g = 0; g + 1 < starts.size(); ++g) {
+    int u = batch[starts[g]].first;
+    std::vector<int> &block = overflow[u];
+    unsigned int r = 0, a = 0;
+    for (int k = starts[g]; k < starts[g + 1]; ++k) {
+      int v = batch[k].second;
+      int i = findBase(u, v);
+      if (i >= 0) {
+        if (edges[i] < 0) {
+          edges[i] = v;
+          ++r;
+        }
+      } else if (std::find(block.begin(), block.end(), v) == block.end()) {
+        block.push_back(v);
+        ++a;
+      }
+    }
+    __atomic_fetch_add(&restored, r, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&added, a, __ATOMIC_RELAXED);
+  }
+
+  nEdges += restored + added;
+  nDeleted -= restored;
+  nOverflow += added;
+  maybeCompact();
+  return restored + added;
+}
+
+int DynGraph::deleteEdges(const int src[], const int dst[], int count) {
+  std::vector<std::pair<int, int>> batch;
+  std::vector<int> starts;
+  if (!sort_batch(src, dst, count, nNodes, batch, starts))
+    return -1;
+
+  // An edge in the base is marked deleted in place; one in an overflow
+  // block is removed from it
+  unsigned int marked = 0, removed = 0;
+  cilk_for(size_t g = 0; g + 1 < starts.size(); ++g) {
+    int u = batch[starts[g]].first;
+    std::vector<int> &block = overflow[u];
+    unsigned int m = 0, r = 0;
+    for (int k = starts[g]; k < starts[g + 1]; ++k) {
+      int v = batch[k].second;
+      int i = findBase(u, v);
+      if (i >= 0 && edges[i] >= 0) {
+        edges[i] = ~v;
+        ++m;
+        continue;
+      }
+      std::vector<int>::iterator it = std::find(block.begin(), block.end(), v);
+      if (it != block.end()) {
+        *it = block.back();
+        block.pop_back();
+        ++r;
+      }
+    }
+    __atomic_fetch_add(&marked, m, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&removed, r, __ATOMIC_RELAXED);
+  }
+
+  nEdges -= marked + removed;
+  nDeleted += marked;
+  nOverflow -= removed;
+  maybeCompact();
+  return marked + removed;
+}
+
+// Build sorted CSR arrays of the edges present
+void DynGraph::compactInto(int **newNodes, int **newEdges) const {
+  int n = nNodes;
+  int *nn = new int[n + 1];
+  cilk_for(int u = 0; u < n; ++u) {
+    int degree = overflow[u].size();
+    for (int i = nodes[u]; i < nodes[u + 1]; ++i)
+      degree += edges[i] >= 0;
+    nn[u] = degree;
+  }
+  int total = 0;
+  for (int u = 0; u < n; ++u) {
+    int prev = nn[u];
+    nn[u] = total;
+    total += prev;
+  }
+  nn[n] = total;
+
+  int *ne = new int[total];
+  cilk_for(int u = 0; u < n; ++u) {
+    int out = nn[u];
+    for (int i = nodes[u]; i < nodes[u + 1]; ++i)
+      if (edges[i] >= 0)
+        ne[out++] = edges[i];
+    int mid = out;
+    for (size_t k = 0; k < overflow[u].size(); ++k)
+      ne[out++] = overflow[u][k];
+    std::sort(ne + mid, ne + out);
+    std::inplace_merge(ne + nn[u], ne + mid, ne + out);
+  }
+
+  *newNodes = nn;
+  *newEdges = ne;
+}
+
+void DynGraph::compact() {
+  int *newNodes, *newEdges;
+  compactInto(&newNodes, &newEdges);
+
+  delete[] this->nodes;
+  delete[] this->edges;
+  this->nodes = newNodes;
+  this->edges = newEdges;
+  cilk_for(int u = 0; u < nNodes; ++u) {
+    std::vector<int>().swap(overflow[u]);
+  }
+  this->nDeleted = 0;
+  this->nOverflow = 0;
+}
+
+// Compact once the changes could slow traversal noticeably
+void DynGraph::maybeCompact() {
+  if ((unsigned long)(nDeleted + nOverflow) * DYN_COMPACT_RATIO > nEdges)
+    compact();
+}
+
+Graph *DynGraph::toGraph() const {
+  int *newNodes, *newEdges;
+  compactInto(&newNodes, &newEdges);
+  return new Graph(newNodes, newEdges, nNodes, newNodes[nNodes]);
+}
+
+// State shared by the walks of one layer of pbfs and pbfs_incremental
+typedef struct {
+  const int *nodes;
+  const int *edges;
+  const std::vector<int> *overflow;
+  unsigned int *distances;
+  unsigned int newdist;
+} DynPhase;
+
+static inline void dyn_proc_Node(const int n[], int fillSize,
+                                 Bag_red<int> &next, const DynPhase &ph) {
+  Bag<int> &bnext = *&next;
+  for (int j = 0; j < fillSize; ++j) {
+    int u = n[j];
+    // Scan the base, skipping deleted edges, and then the inserted edges
+    for (int i = ph.nodes[u]; i < ph.nodes[u + 1]; ++i) {
+      // Ignore races on distances[edge]
+      Cilksan_fake_lock_guard guard(&mtx);
+      int edge = ph.edges[i];
+      if (edge >= 0 && ph.newdist < ph.distances[edge]) {
+        bnext.insert(edge);
+        ph.distances[edge] = ph.newdist;
+      }
+    }
+    const std::vector<int> &block = ph.overflow[u];
+    for (size_t k = 0; k < block.size(); ++k) {
+      Cilksan_fake_lock_guard guard(&mtx);
+      int edge = block[k];
+      if (ph.newdist < ph.distances[edge]) {
+        bnext.insert(edge);
+        ph.distances[edge] = ph.newdist;
+      }
+    }
+  }
+}
+
+// PBFS over the base and the overflow blocks, as Graph::pbfs
+int DynGraph::pbfs(const int s, unsigned int distances[]) const {
+  if (s < 0 || s >= nNodes)
+    return -1;
+
+  Bag_red<int> b1;
+  Bag_red<int> b2;
+  Bag_red<int> *queue[2] = {__builtin_addressof(b1), __builtin_addressof(b2)};
+  bool queuei = 0;
+
+  cilk_for(int i = 0; i < nNodes; ++i) distances[i] = UINT_MAX;
+
+  distances[s] = 0;
+  queue[queuei]->insert(s);
+  unsigned int newdist = 1;
+
+  while (!(queue[queuei]->isEmpty())) {
+    queue[!queuei]->clear();
+    DynPhase ph = {nodes, edges, overflow, distances, newdist};
+    walk_Bag<Bag_red<int>, DynPhase,
+             walk_Filling<Bag_red<int>, DynPhase, dyn_proc_Node>>(
+        *queue[queuei], *queue[!queuei], ph);
+    queuei = !queuei;
+    ++newdist;
+  }
+
+  return 0;
+}
+
+// Incremental BFS: an inserted edge (u, v) lowers v's distance to
+// distances[u] + 1 if that is smaller.  Those seeds are sorted by their
+// new distances, and the layers are then expanded as in pbfs, each
+// layer gaining the seeds at its distance.  A seed whose distance has
+// meanwhile dropped further is skipped.
+int DynGraph::pbfs_incremental(unsigned int distances[], const int src[],
+                               const int dst[], int count) const {
+  for (int k = 0; k < count; ++k)
+    if (src[k] < 0 || src[k] >= nNodes || dst[k] < 0 || dst[k] >= nNodes)
+      return -1;
+
+  std::vector<std::pair<unsigned int, int>> seeds;
+  for (int k = 0; k < count; ++k) {
+    unsigned int d = distances[src[k]];
+    if (d != UINT_MAX && d + 1 < distances[dst[k]]) {
+      distances[dst[k]] = d + 1;
+      seeds.push_back(std::make_pair(d + 1, dst[k]));
+    }
+  }
+  std::sort(seeds.begin(), seeds.end());
+  seeds.erase(std::unique(seeds.begin(), seeds.end()), seeds.end());
+
+  Bag_red<int> b1;
+  Bag_red<int> b2;
+  Bag_red<int> *queue[2] = {__builtin_addressof(b1), __builtin_addressof(b2)};
+  bool queuei = 0;
+  size_t next = 0;
+  // Distance of the nodes in the frontier
+  unsigned int dist = 0;
+
+  while (next < seeds.size() || !queue[queuei]->isEmpty()) {
+    // Skip ahead to the next seed when the frontier dies out
+    if (queue[queuei]->isEmpty())
+      dist = seeds[next].first;
+    for (; next < seeds.size() && seeds[next].first == dist; ++next)
+      if (distances[seeds[next].second] == dist)
+        queue[queuei]->insert(seeds[next].second);
+
+    queue[!queuei]->clear();
+    DynPhase ph = {nodes, edges, overflow, distances, dist + 1};
+    walk_Bag<Bag_red<int>, DynPhase,
+             walk_Filling<Bag_red<int>, DynPhase, dyn_proc_Node>>(
+        *queue[queuei], *queue[!queuei], ph);
+    queuei = !queuei;
+    ++dist;
+  }
+
+  return 0;
+}
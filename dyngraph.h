@@ -0,0 +1,94 @@
+// Copyright (c) 2010-2024, Tao B. Schardl
+/*
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef DYNGRAPH_H
+#define DYNGRAPH_H
+
+#include "graph.h"
+#include <vector>
+
+// A DynGraph compacts itself once its inserted and deleted edges exceed
+// 1/DYN_COMPACT_RATIO of its edges
+#ifndef DYN_COMPACT_RATIO
+#define DYN_COMPACT_RATIO 8
+#endif
+
+// Unweighted graph that changes by batches of edge insertions and
+// deletions.  Its edges are a CSR base, in which a deleted neighbor v
+// is marked in place as ~v, plus a block of inserted neighbors for each
+// node.  Compaction merges the blocks into the base and drops the
+// deleted edges, so that traversal stays close to static CSR speed.
+class DynGraph {
+
+private:
+  // Number of nodes
+  unsigned int nNodes;
+  // Number of edges present
+  unsigned int nEdges;
+
+  int *nodes;
+  // Each node's neighbors in the base, sorted by neighbor
+  int *edges;
+  // Each node's inserted neighbors
+  std::vector<int> *overflow;
+
+  // Deleted edges marked in the base, and edges in the overflow blocks
+  unsigned int nDeleted;
+  unsigned int nOverflow;
+
+  int findBase(int u, int v) const;
+  void compactInto(int **newNodes, int **newEdges) const;
+  void maybeCompact();
+
+public:
+  // Constructor/Destructor
+  DynGraph(const Graph &graph);
+  ~DynGraph();
+
+  // Accessors for basic graph data
+  inline u_int numNodes() const { return nNodes; }
+  inline u_int numEdges() const { return nEdges; }
+
+  bool hasEdge(int u, int v) const;
+
+  // Insert the edges (src[k], dst[k]) for k in [0, count) that are not
+  // present, or delete those that are.  Return the number of edges
+  // inserted or deleted, or -1 if an edge has an invalid node.
+  int insertEdges(const int src[], const int dst[], int count);
+  int deleteEdges(const int src[], const int dst[], int count);
+
+  // Merge the inserted edges into the base and drop the deleted ones
+  void compact();
+  // A static copy of the current graph
+  Graph *toGraph() const;
+
+  int pbfs(const int s, unsigned int distances[]) const;
+  // Update the distances from a search of this graph after the edges
+  // (src[k], dst[k]) for k in [0, count) were inserted.  Only the nodes
+  // whose distances decrease are visited.  Deletions are not handled,
+  // since they can increase distances.
+  int pbfs_incremental(unsigned int distances[], const int src[],
+                       const int dst[], int count) const;
+};
+
+#endif // DYNGRAPH_H
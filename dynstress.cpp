@@ -0,0 +1,248 @@
+// Copyright (c) 2010-2024, Tao B. Schardl
+/*
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// Randomized check of DynGraph.  Batches of random edge insertions and
+// deletions are applied both to a DynGraph and to a sorted edge set,
+// and after each batch the DynGraph's edge count, hasEdge, toGraph,
+// pbfs and pbfs_incremental are compared against the edge set.  Run
+// under different values of CILK_NWORKERS to vary the worker count.
+
+#include "pbfs.h"
+#include <cilk/cilk_api.h>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+typedef set<pair<int, int>> EdgeSet;
+
+// Structure defining command line argument values
+typedef struct {
+  const char *spec;
+  int rounds;
+  int batch;
+  unsigned long seed;
+} DynStressArgs;
+
+static void print_usage(char *argv0) {
+  fprintf(stderr, "Usage: %s [-g <spec>] [-r <rounds>] [-b <batch>] "
+                  "[-s <seed>]\n",
+          argv0);
+  fprintf(stderr, "Flags are:\n");
+  fprintf(stderr, "\t-g <spec>\t: Graph to start from, as for bfs -g "
+                  "(default er:4096:8).\n");
+  fprintf(stderr, "\t-r <rounds>\t: Number of batches to apply.\n");
+  fprintf(stderr, "\t-b <batch>\t: Largest number of edges in a batch.\n");
+  fprintf(stderr, "\t-s <seed>\t: Seed of the random batches.\n");
+  exit(1);
+}
+
+static DynStressArgs parse_args(int argc, char *argv[]) {
+  DynStressArgs theArgs;
+  theArgs.spec = "er:4096:8";
+  theArgs.rounds = 60;
+  theArgs.batch = 4096;
+  theArgs.seed = 1;
+
+  for (int arg_i = 1; arg_i < argc; ++arg_i) {
+    char *arg = argv[arg_i];
+
+    if (strcmp(arg, "-g") == 0 && arg_i + 1 < argc) {
+      theArgs.spec = argv[++arg_i];
+    } else if (strcmp(arg, "-r") == 0 && arg_i + 1 < argc) {
+      theArgs.rounds = atoi(argv[++arg_i]);
+    } else if (strcmp(arg, "-b") == 0 && arg_i + 1 < argc) {
+      theArgs.batch = atoi(argv[++arg_i]);
+    } else if (strcmp(arg, "-s") == 0 && arg_i + 1 < argc) {
+      theArgs.seed = strtoul(argv[++arg_i], NULL, 0);
+    } else {
+      print_usage(argv[0]);
+    }
+  }
+  if (theArgs.rounds <= 0 || theArgs.batch <= 0)
+    print_usage(argv[0]);
+
+  return theArgs;
+}
+
+// Counter-based hash, as in bagbench
+static inline uint64_t hash64(uint64_t seed, uint64_t i) {
+  uint64_t z = seed + (i + 1) * 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// A static graph holding the edges in ref
+static Graph *toGraph(const EdgeSet &ref, int n) {
+  int *nodes = new int[n + 1];
+  int *edges = new int[ref.size()];
+  int k = 0, u = 0;
+  nodes[0] = 0;
+  for (const pair<int, int> &e : ref) {
+    while (u < e.first)
+      nodes[++u] = k;
+    edges[k++] = e.second;
+  }
+  while (u < n)
+    nodes[++u] = k;
+  return new Graph(nodes, edges, n, k);
+}
+
+// Fill a batch of count edges.  In a deletion batch, about half of them
+// are present in ref; the others, and all the edges of an insertion
+// batch, are random and may repeat.
+static void random_batch(const EdgeSet &ref, int n, int count, bool del,
+                         uint64_t seed, int src[], int dst[]) {
+  for (int k = 0; k < count; ++k) {
+    uint64_t r = hash64(seed, k);
+    if (del && r % 2 == 0 && !ref.empty()) {
+      EdgeSet::const_iterator it =
+          ref.lower_bound(make_pair((int)(r / 2 % n), 0));
+      if (it == ref.end())
+        it = ref.begin();
+      src[k] = it->first;
+      dst[k] = it->second;
+    } else {
+      src[k] = (int)(r % n);
+      dst[k] = (int)(hash64(seed ^ 0x5bd1e995, k) % n);
+    }
+  }
+}
+
+static bool check(const DynStressArgs &args) {
+  Graph *graph;
+  if (generateGraph(args.spec, &graph) != 0)
+    return false;
+  graph->simplify(false, false, true);
+  int n = graph->numNodes();
+  if (n == 0) {
+    delete graph;
+    return true;
+  }
+
+  DynGraph dyn(*graph);
+  EdgeSet ref;
+  for (int u = 0; u < n; ++u)
+    for (int i = graph->getNodes()[u]; i < graph->getNodes()[u + 1]; ++i)
+      ref.insert(make_pair(u, graph->getEdges()[i]));
+  delete graph;
+
+  vector<unsigned int> expected(n), found(n), incremental(n);
+  vector<int> src(args.batch), dst(args.batch);
+  int s0 = (int)(hash64(args.seed, 0) % n);
+  dyn.pbfs(s0, &incremental[0]);
+
+  bool ok = true;
+  for (int round = 0; round < args.rounds && ok; ++round) {
+    uint64_t rseed = hash64(args.seed, round + 1);
+    int count = 1 + (int)(rseed % args.batch);
+    bool del = round % 3 == 2;
+    random_batch(ref, n, count, del, rseed, &src[0], &dst[0]);
+
+    int changed = 0;
+    for (int k = 0; k < count; ++k) {
+      pair<int, int> e = make_pair(src[k], dst[k]);
+      changed += del ? ref.erase(e) : ref.insert(e).second;
+    }
+    int r = del ? dyn.deleteEdges(&src[0], &dst[0], count)
+                : dyn.insertEdges(&src[0], &dst[0], count);
+    if (r != changed) {
+      fprintf(stderr, "round %d: %s %d edges, expected %d\n", round,
+              del ? "deleted" : "inserted", r, changed);
+      ok = false;
+    }
+    if (dyn.numEdges() != ref.size()) {
+      fprintf(stderr, "round %d: %u edges, expected %zu\n", round,
+              dyn.numEdges(), ref.size());
+      ok = false;
+    }
+
+    for (int q = 0; q < 256 && ok; ++q) {
+      int u = (int)(hash64(rseed, 2 * q + 1) % n);
+      int v = (int)(hash64(rseed, 2 * q + 2) % n);
+      if (dyn.hasEdge(u, v) != (ref.count(make_pair(u, v)) > 0)) {
+        fprintf(stderr, "round %d: hasEdge(%d, %d) is wrong\n", round, u, v);
+        ok = false;
+      }
+    }
+
+    Graph *refGraph = toGraph(ref, n);
+    Graph *copy = dyn.toGraph();
+    if (copy->numEdges() != refGraph->numEdges() ||
+        memcmp(copy->getNodes(), refGraph->getNodes(),
+               (n + 1) * sizeof(int)) != 0 ||
+        memcmp(copy->getEdges(), refGraph->getEdges(),
+               refGraph->numEdges() * sizeof(int)) != 0) {
+      fprintf(stderr, "round %d: toGraph differs\n", round);
+      ok = false;
+    }
+    delete copy;
+
+    int s = (int)(rseed % n);
+    refGraph->bfs(s, &expected[0]);
+    dyn.pbfs(s, &found[0]);
+    if (found != expected) {
+      fprintf(stderr, "round %d: pbfs from %d differs\n", round, s);
+      ok = false;
+    }
+
+    // Deletions can increase distances, so restart the incremental
+    // search after them
+    refGraph->bfs(s0, &expected[0]);
+    if (del) {
+      dyn.pbfs(s0, &incremental[0]);
+    } else {
+      dyn.pbfs_incremental(&incremental[0], &src[0], &dst[0], count);
+      if (incremental != expected) {
+        fprintf(stderr, "round %d: pbfs_incremental from %d differs\n",
+                round, s0);
+        ok = false;
+      }
+    }
+    delete refGraph;
+  }
+
+  // A batch with an invalid node is rejected
+  int bad = n;
+  if (dyn.insertEdges(&bad, &bad, 1) != -1 ||
+      dyn.deleteEdges(&bad, &bad, 1) != -1 ||
+      dyn.pbfs_incremental(&incremental[0], &bad, &bad, 1) != -1) {
+    fprintf(stderr, "an invalid node was accepted\n");
+    ok = false;
+  }
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  DynStressArgs args = parse_args(argc, argv);
+  bool ok = check(args);
+  printf("dynstress,%s,%lu,%u,%s\n", args.spec, args.seed,
+         __cilkrts_get_nworkers(), ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
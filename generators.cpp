@@ -0,0 +1,282 @@
+// Copyright (c) 2010-2024, Tao B. Schardl
+/*
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Synthetic graph generators for libpbfs
+#include "pbfs.h"
+#include <cilk/cilk.h>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Graph500 Kronecker initiator probabilities; the fourth is 1 - A - B - C
+const double KRON_A = 0.57;
+const double KRON_B = 0.19;
+const double KRON_C = 0.19;
+
+#define GEN_PREFIX_BLOCK 4096
+
+// Counter-based random numbers, the SplitMix64 output function of seed
+// and k.  Each edge draws from its own range of k, so edges can be made
+// in any order, in parallel, with the same result for a given seed.
+static inline unsigned long long gen_random(unsigned long long seed,
+                                            unsigned long long k) {
+  unsigned long long z = seed + (k + 1) * 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1)
+static inline double gen_uniform(unsigned long long seed,
+                                 unsigned long long k) {
+  return (gen_random(seed, k) >> 11) * 0x1.0p-53;
+}
+
+// Replace arr[0..n) with its exclusive prefix sums and return the total
+static long long gen_prefix_sum(int arr[], int n) {
+  int nblocks = (n + GEN_PREFIX_BLOCK - 1) / GEN_PREFIX_BLOCK;
+  long long *sums = new long long[nblocks];
+
+  cilk_for(int b = 0; b < nblocks; ++b) {
+    int end = min(n, (b + 1) * GEN_PREFIX_BLOCK);
+    long long sum = 0;
+    for (int i = b * GEN_PREFIX_BLOCK; i < end; ++i)
+      sum += arr[i];
+    sums[b] = sum;
+  }
+
+  long long total = 0;
+  for (int b = 0; b < nblocks; ++b) {
+    long long prev = sums[b];
+    sums[b] = total;
+    total += prev;
+  }
+
+  cilk_for(int b = 0; b < nblocks; ++b) {
+    int end = min(n, (b + 1) * GEN_PREFIX_BLOCK);
+    long long sum = sums[b];
+    for (int i = b * GEN_PREFIX_BLOCK; i < end; ++i) {
+      int prev = arr[i];
+      arr[i] = sum;
+      sum += prev;
+    }
+  }
+
+  delete[] sums;
+  return total;
+}
+
+// Build a graph on n nodes with both directions of the edges
+// (src[k], dst[k]) for k in [0, m), which are freed
+static Graph *gen_build(int n, int *src, int *dst, long long m) {
+  int *nodes = new int[n + 1];
+  cilk_for(int u = 0; u < n; ++u) nodes[u] = 0;
+  cilk_for(long long k = 0; k < m; ++k) {
+    __atomic_fetch_add(&nodes[src[k]], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&nodes[dst[k]], 1, __ATOMIC_RELAXED);
+  }
+  int nnz = gen_prefix_sum(nodes, n);
+  nodes[n] = nnz;
+
+  // The Graph constructor sorts each node's neighbors, so the order in
+  // which they are placed here does not matter
+  int *w = new int[n];
+  cilk_for(int u = 0; u < n; ++u) w[u] = nodes[u];
+  int *edges = new int[nnz];
+  cilk_for(long long k = 0; k < m; ++k) {
+    edges[__atomic_fetch_add(&w[src[k]], 1, __ATOMIC_RELAXED)] = dst[k];
+    edges[__atomic_fetch_add(&w[dst[k]], 1, __ATOMIC_RELAXED)] = src[k];
+  }
+
+  delete[] w;
+  delete[] src;
+  delete[] dst;
+  return new Graph(nodes, edges, n, nnz);
+}
+
+// Check that m undirected edges fit in a graph's edge array
+static bool gen_fits(long long m) {
+  if (m < 0 || m > INT_MAX / 2) {
+    fprintf(stderr, "Too many edges to generate: %lld\n", m);
+    return false;
+  }
+  return true;
+}
+
+int generateKronecker(int scale, int edgeFactor, unsigned long long seed,
+                      Graph **graph) {
+  if (scale < 1 || scale > 30 || edgeFactor < 1) {
+    fprintf(stderr, "Invalid Kronecker scale %d or edge factor %d\n", scale,
+            edgeFactor);
+    return -1;
+  }
+  long long m = (long long)edgeFactor << scale;
+  if (!gen_fits(m))
+    return -1;
+
+  // Relabel the nodes by a bijection of [0, 2^scale), odd multipliers
+  // and an xorshift, so that the high-degree nodes are not clustered
+  // at low labels
+  unsigned long long mask = (1ULL << scale) - 1;
+  unsigned long long mul1 = gen_random(seed, ~0ULL) | 1;
+  unsigned long long mul2 = gen_random(seed, ~1ULL) | 1;
+  int shift = (scale + 1) / 2;
+
+  int *src = new int[m];
+  int *dst = new int[m];
+  cilk_for(long long k = 0; k < m; ++k) {
+    // Descend the adjacency matrix one quadrant per level
+    unsigned long long u = 0, v = 0;
+    for (int level = 0; level < scale; ++level) {
+      double r = gen_uniform(seed, (unsigned long long)k * 32 + level);
+      int row = r >= KRON_A + KRON_B;
+      int col = row ? r >= KRON_A + KRON_B + KRON_C : r >= KRON_A;
+      u = u << 1 | row;
+      v = v << 1 | col;
+    }
+    u = (u * mul1) & mask;
+    u = ((u ^ (u >> shift)) * mul2) & mask;
+    v = (v * mul1) & mask;
+    v = ((v ^ (v >> shift)) * mul2) & mask;
+    src[k] = u;
+    dst[k] = v;
+  }
+
+  *graph = gen_build(1 << scale, src, dst, m);
+  return 0;
+}
+
+int generateGrid(int side, int dims, Graph **graph) {
+  if (side < 1 || dims < 1 || dims > 3) {
+    fprintf(stderr, "Invalid grid side %d or dimensions %d\n", side, dims);
+    return -1;
+  }
+  long long n = 1;
+  for (int d = 0; d < dims; ++d)
+    n *= side;
+  if (n > INT_MAX) {
+    fprintf(stderr, "Too many nodes to generate: %d^%d\n", side, dims);
+    return -1;
+  }
+  if (!gen_fits(n * dims))
+    return -1;
+
+  int stride[3] = {1, 1, 1};
+  for (int d = 1; d < dims; ++d)
+    stride[d] = stride[d - 1] * side;
+  int *nodes = new int[n + 1];
+  cilk_for(int u = 0; u < n; ++u) {
+    int degree = 0;
+    for (int d = 0; d < dims; ++d) {
+      int c = u / stride[d] % side;
+      degree += (c > 0) + (c < side - 1);
+    }
+    nodes[u] = degree;
+  }
+  int nnz = gen_prefix_sum(nodes, n);
+  nodes[n] = nnz;
+
+  // List the neighbors in increasing order
+  int *edges = new int[nnz];
+  cilk_for(int u = 0; u < n; ++u) {
+    int i = nodes[u];
+    for (int d = dims - 1; d >= 0; --d)
+      if (u / stride[d] % side > 0)
+        edges[i++] = u - stride[d];
+    for (int d = 0; d < dims; ++d)
+      if (u / stride[d] % side < side - 1)
+        edges[i++] = u + stride[d];
+  }
+
+  *graph = new Graph(nodes, edges, n, nnz);
+  return 0;
+}
+
+int generateUniform(int n, int degree, unsigned long long seed,
+                    Graph **graph) {
+  if (n < 1 || degree < 1) {
+    fprintf(stderr, "Invalid node count %d or degree %d\n", n, degree);
+    return -1;
+  }
+  long long m = (long long)n * degree / 2;
+  if (!gen_fits(m))
+    return -1;
+
+  int *src = new int[m];
+  int *dst = new int[m];
+  cilk_for(long long k = 0; k < m; ++k) {
+    src[k] = gen_random(seed, 2 * k) % n;
+    dst[k] = gen_random(seed, 2 * k + 1) % n;
+  }
+
+  *graph = gen_build(n, src, dst, m);
+  return 0;
+}
+
+// Parse the colon-separated numbers of a generator spec into args,
+// keeping the defaults of those left out.  The first nints must fit in
+// an int.
+static bool gen_parse(const string &spec, size_t start,
+                      vector<long long> &args, size_t nints) {
+  size_t i = 0;
+  while (start < spec.size()) {
+    if (i == args.size())
+      return false;
+    const char *first = spec.c_str() + start;
+    char *last;
+    long long arg = strtoll(first, &last, 10);
+    if (last == first || (*last != ':' && *last != '\0'))
+      return false;
+    if (i < nints && (arg < INT_MIN || arg > INT_MAX))
+      return false;
+    args[i++] = arg;
+    start = last - spec.c_str() + 1;
+  }
+  return true;
+}
+
+int generateGraph(const string spec, Graph **graph) {
+  size_t colon = spec.find(':');
+  string kind = spec.substr(0, colon);
+  size_t start = colon == string::npos ? spec.size() : colon + 1;
+
+  if (kind == "kron") {
+    vector<long long> args = {-1, 16, 1};
+    if (gen_parse(spec, start, args, 2))
+      return generateKronecker(args[0], args[1], args[2], graph);
+  } else if (kind == "grid") {
+    vector<long long> args = {-1, 3};
+    if (gen_parse(spec, start, args, 2))
+      return generateGrid(args[0], args[1], graph);
+  } else if (kind == "er") {
+    vector<long long> args = {-1, 16, 1};
+    if (gen_parse(spec, start, args, 2))
+      return generateUniform(args[0], args[1], args[2], graph);
+  }
+  fprintf(stderr, "Invalid graph generator %s\n", spec.c_str());
+  return -1;
+}
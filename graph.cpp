@@ -24,18 +24,43 @@
 // Graph Representation
 #include "graph.h"
 #include "bag.h"
+#include "bagwalk.h"
+#include <algorithm>
 #include <cilk/cilk.h>
+#include <cilk/cilk_api.h>
 #include <cilk/cilksan.h>
 #include <climits>
+#include <cmath>
+#include <cstdio>
 #include <cstdlib>
+#include <queue>
+#include <sys/mman.h>
 #include <sys/types.h>
 
 #define GraphDebug 0
 #define RAND 0
 
-#define THRESHOLD 256
+// Grain sizes may be overridden at compile time, e.g., with the values
+// that graphstats recommends
+#ifndef EDGE_THRESHOLD
 #define EDGE_THRESHOLD 128
+#endif
+// Edges per leaf of pbfs_balanced
+#ifndef BALANCED_GRAIN
+#define BALANCED_GRAIN 2048
+#endif
+#ifndef PARALLEL_EDGES
 #define PARALLEL_EDGES false
+#endif
+#define PREFIX_SUM_BLOCK 4096
+#define BOTTOM_UP_BLOCK 1024
+// Direction-optimizing switch points: go bottom-up once the frontier's
+// edges exceed 1/DO_ALPHA of the unexplored edges, and back top-down
+// once the frontier holds fewer than 1/DO_BETA of the nodes
+#define DO_ALPHA 14
+#define DO_BETA 24
+// Number of delta-stepping buckets held at once
+#define SSSP_BUCKETS 64
 
 Graph::Graph(int *ir, int *jc, int m, int n, int nnz) {
   this->nNodes = m;
@@ -66,18 +91,119 @@ Graph::Graph(int *ir, int *jc, int m, int n, int nnz) {
     this->nodes[i] = w[i];
   // memcpy(v, w, m);
 
+  // Scanning the columns in order leaves each node's neighbors sorted
   for (int i = 0; i < n; ++i) {
     for (int j = jc[i]; j < jc[i + 1]; j++)
       this->edges[w[ir[j]]++] = i;
   }
+  this->weights = NULL;
+  this->ownership = GRAPH_OWNED;
+  this->mapBase = NULL;
+  this->mapLength = 0;
+  this->parentNodes = NULL;
+  this->parents = NULL;
+  this->layerHook = NULL;
+  this->layerHookArg = NULL;
 
   delete[] w;
   // delete[] v;
 }
 
+// Sort edges[begin..end), and the weights with them, if any, by
+// neighbor and then by weight
+static void sort_neighbors(int edges[], double weights[], int begin,
+                           int end) {
+  if (weights == NULL) {
+    std::sort(edges + begin, edges + end);
+    return;
+  }
+  std::vector<std::pair<int, double>> e(end - begin);
+  for (int i = begin; i < end; ++i)
+    e[i - begin] = std::make_pair(edges[i], weights[i]);
+  std::sort(e.begin(), e.end());
+  for (int i = begin; i < end; ++i) {
+    edges[i] = e[i - begin].first;
+    weights[i] = e[i - begin].second;
+  }
+}
+
+// Construct a graph from the CSR arrays nodes[0..n] and edges[0..nnz),
+// and optionally the edge weights[0..nnz), without copying them.  The
+// neighbors of an owned graph are sorted here.  Those of a borrowed
+// graph must already be sorted, since the graph never writes to arrays
+// that it does not own.
+Graph::Graph(int *nodes, int *edges, int n, int nnz, double *weights,
+             GraphOwnership ownership) {
+  this->nNodes = n;
+  this->nEdges = nnz;
+  this->nodes = nodes;
+  this->edges = edges;
+  this->weights = weights;
+  this->ownership = ownership;
+  this->mapBase = NULL;
+  this->mapLength = 0;
+  this->parentNodes = NULL;
+  this->parents = NULL;
+  this->layerHook = NULL;
+  this->layerHookArg = NULL;
+
+  // Keep each node's neighbors sorted
+  if (ownership == GRAPH_OWNED) {
+    cilk_for(int u = 0; u < n; ++u) {
+      if (!std::is_sorted(edges + nodes[u], edges + nodes[u + 1]))
+        sort_neighbors(edges, weights, nodes[u], nodes[u + 1]);
+    }
+  }
+}
+
+// Construct a graph from sorted CSR arrays that lie in the mapping
+// [base, base + length), which the graph unmaps when it is destroyed
+Graph::Graph(void *base, size_t length, int *nodes, int *edges, int n,
+             int nnz, double *weights)
+    : Graph(nodes, edges, n, nnz, weights, GRAPH_MAPPED) {
+  this->mapBase = base;
+  this->mapLength = length;
+}
+
 Graph::~Graph() {
-  delete[] this->nodes;
-  delete[] this->edges;
+  releaseArrays();
+  delete[] this->parentNodes;
+  delete[] this->parents;
+}
+
+// Free the CSR arrays, as the ownership policy says
+void Graph::releaseArrays() {
+  if (ownership == GRAPH_OWNED) {
+    delete[] this->nodes;
+    delete[] this->edges;
+    delete[] this->weights;
+  } else if (ownership == GRAPH_MAPPED) {
+    munmap(this->mapBase, this->mapLength);
+  }
+}
+
+// Replace the CSR arrays with copies that the graph owns
+void Graph::copyArrays() {
+  int n = nNodes, nnz = nEdges;
+  int *newNodes = new int[n + 1];
+  int *newEdges = new int[nnz];
+  double *newWeights = weights ? new double[nnz] : NULL;
+  const int *nodes = this->nodes, *edges = this->edges;
+  const double *weights = this->weights;
+  cilk_for(int u = 0; u <= n; ++u) newNodes[u] = nodes[u];
+  cilk_for(int i = 0; i < nnz; ++i) {
+    newEdges[i] = edges[i];
+    if (weights)
+      newWeights[i] = weights[i];
+  }
+
+  releaseArrays();
+  this->nodes = newNodes;
+  this->edges = newEdges;
+  this->weights = newWeights;
+  this->ownership = GRAPH_OWNED;
+  this->mapBase = NULL;
+  this->mapLength = 0;
 }
 
 int Graph::bfs(const int s, unsigned int distances[]) const {
@@ -85,7 +211,7 @@ int Graph::bfs(const int s, unsigned int distances[]) const {
   unsigned int head, tail;
   unsigned int current, newdist;
 
-  if (s < 0 || s > nNodes)
+  if (s < 0 || s >= nNodes)
     return -1;
 
   for (int i = 0; i < nNodes; ++i) {
@@ -116,20 +242,80 @@ int Graph::bfs(const int s, unsigned int distances[]) const {
   return 0;
 }
 
+// Record v as a node that fails verify, keeping the least such node
+static inline void verify_fail(int *bad, int v) {
+  int cur = __atomic_load_n(bad, __ATOMIC_RELAXED);
+  while (v < cur && !__atomic_compare_exchange_n(bad, &cur, v, false,
+                                                 __ATOMIC_RELAXED,
+                                                 __ATOMIC_RELAXED))
+    ;
+}
+
+// Parallel check of the BFS invariants: s alone is at distance 0, each
+// edge (u, v) from a reached u has distances[v] <= distances[u] + 1,
+// and each other reached v has an edge from a node one closer to s.
+// Only the BFS distances satisfy all three, so no reference search is
+// needed.
+int Graph::verify(const int s, const unsigned int distances[],
+                  int *bad) const {
+  if (s < 0 || s >= nNodes)
+    return -1;
+
+  int first = distances[s] == 0 ? INT_MAX : s;
+  // Whether each node has an edge from a node one closer to s
+  bool *justified = new bool[nNodes];
+  cilk_for(int v = 0; v < nNodes; ++v) justified[v] = false;
+
+  cilk_for(int u = 0; u < nNodes; ++u) {
+    unsigned int du = distances[u];
+    if (du == 0 && u != s)
+      verify_fail(&first, u);
+    if (du == UINT_MAX)
+      continue;
+    for (int i = nodes[u]; i < nodes[u + 1]; ++i) {
+      int v = edges[i];
+      unsigned int dv = distances[v];
+      if (dv > du + 1)
+        verify_fail(&first, v);
+      else if (dv == du + 1 &&
+               !__atomic_load_n(&justified[v], __ATOMIC_RELAXED))
+        __atomic_store_n(&justified[v], true, __ATOMIC_RELAXED);
+    }
+  }
+
+  cilk_for(int v = 0; v < nNodes; ++v) {
+    if (v != s && distances[v] != UINT_MAX && !justified[v])
+      verify_fail(&first, v);
+  }
+
+  delete[] justified;
+  if (first == INT_MAX)
+    return 0;
+  if (bad != NULL)
+    *bad = first;
+  return -1;
+}
+
 // Fake lock to ignore known races on reading and writing distances[] array.
-Cilksan_fake_mutex mtx;
+static Cilksan_fake_mutex mtx;
+
+// State shared by the walks of one layer of pbfs and pbfs_balanced
+typedef struct {
+  const int *nodes;
+  const int *edges;
+  unsigned int *distances;
+  unsigned int newdist;
+} PBFSPhase;
 
 static inline void pbfs_proc_Node(const int n[], int fillSize,
-                                  Bag_red<int> &next, uint newdist,
-                                  uint distances[], const int nodes[],
-                                  const int edges[]) {
+                                  Bag_red<int> &next, const PBFSPhase &ph) {
   // Process the current element
   // Bag<int> &bnext = *&next;
   for (int j = 0; j < fillSize; ++j) {
     // Scan the edges of the current node and add untouched
     // neighbors to the opposite bag
-    int edgeZero = nodes[n[j]];
-    int edgeLast = nodes[n[j] + 1];
+    int edgeZero = ph.nodes[n[j]];
+    int edgeLast = ph.nodes[n[j] + 1];
 
 #if PARALLEL_EDGES
     cilk_for(int ii = 0;
@@ -147,59 +333,16 @@ static inline void pbfs_proc_Node(const int n[], int fillSize,
       for (int i = localEdgeZero; i < localEdgeLast; ++i) {
         // Ignore races on distances[edge]
         Cilksan_fake_lock_guard guard(&mtx);
-        int edge = edges[i];
-        if (newdist < distances[edge]) {
+        int edge = ph.edges[i];
+        if (ph.newdist < ph.distances[edge]) {
           bnext.insert(edge);
-          distances[edge] = newdist;
+          ph.distances[edge] = ph.newdist;
         }
       }
     }
   }
 }
 
-inline void Graph::pbfs_walk_Bag(Bag<int> &b, Bag_red<int> &next,
-                                 unsigned int newdist,
-                                 unsigned int distances[]) const {
-  if (b.getFill() > 0) {
-    // Split the bag and recurse
-    Pennant<int> *p = NULL;
-
-    b.split(&p); // Destructive split, decrements b.getFill()
-    cilk_spawn pbfs_walk_Pennant(p, next, newdist, distances);
-    pbfs_walk_Bag(b, next, newdist, distances);
-  } else {
-    int fillSize = b.getFillingSize();
-    const int *n = b.getFilling();
-    int extraFill = fillSize % THRESHOLD;
-    cilk_spawn pbfs_proc_Node(n + fillSize - extraFill, extraFill, next,
-                              newdist, distances, nodes, edges);
-    // #pragma cilk grainsize 1
-    cilk_for(int i = 0; i < fillSize - extraFill; i += THRESHOLD) {
-      pbfs_proc_Node(n + i, THRESHOLD, next, newdist, distances, nodes, edges);
-    }
-  }
-}
-
-inline void Graph::pbfs_walk_Pennant(Pennant<int> *p, Bag_red<int> &next,
-                                     unsigned int newdist,
-                                     unsigned int distances[]) const {
-  cilk_scope {
-    if (p->getLeft() != NULL)
-      cilk_spawn pbfs_walk_Pennant(p->getLeft(), next, newdist, distances);
-
-    if (p->getRight() != NULL)
-      cilk_spawn pbfs_walk_Pennant(p->getRight(), next, newdist, distances);
-
-    const int *n = p->getElements();
-    // #pragma cilk grainsize 1
-    cilk_for(int i = 0; i < BLK_SIZE; i += THRESHOLD) {
-      // This is fine as long as THRESHOLD divides BLK_SIZE
-      pbfs_proc_Node(n + i, THRESHOLD, next, newdist, distances, nodes, edges);
-    }
-  }
-  delete p;
-}
-
 int Graph::pbfs(const int s, unsigned int distances[]) const {
 #if REDUCER_IMPL == REDUCER_ARRAY
   Bag_red<int> queue[2];
@@ -215,13 +358,15 @@ int Graph::pbfs(const int s, unsigned int distances[]) const {
   // unsigned int current;
   unsigned int newdist;
 
-  if (s < 0 || s > nNodes)
+  if (s < 0 || s >= nNodes)
     return -1;
 
   cilk_for(int i = 0; i < nNodes; ++i) distances[i] = UINT_MAX;
 
   distances[s] = 0;
 
+  if (layerHook != NULL)
+    layerHook(layerHookArg, 0, 1);
   // Scan the edges of the initial node and add untouched
   // neighbors to the opposite bag
   cilk_for(int i = nodes[s]; i < nodes[s + 1]; ++i) {
@@ -242,16 +387,1271 @@ int Graph::pbfs(const int s, unsigned int distances[]) const {
   while (!(queue[queuei].isEmpty()))
 #endif // REDUCER_IMPL
   {
+    PBFSPhase ph = {nodes, edges, distances, newdist};
 #if REDUCER_IMPL == REDUCER_PTRS
+    if (layerHook != NULL)
+      layerHook(layerHookArg, newdist - 1, queue[queuei]->numElements());
     queue[!queuei]->clear();
-    pbfs_walk_Bag(*queue[queuei], *queue[!queuei], newdist, distances);
+    walk_Bag<Bag_red<int>, PBFSPhase,
+             walk_Filling<Bag_red<int>, PBFSPhase, pbfs_proc_Node>>(
+        *queue[queuei], *queue[!queuei], ph);
 #else  // REDUCER_IMPL == REDUCER_ARRAY
+    if (layerHook != NULL)
+      layerHook(layerHookArg, newdist - 1, queue[queuei].numElements());
     queue[!queuei].clear();
-    pbfs_walk_Bag(*&queue[queuei], queue[!queuei], newdist, distances);
+    walk_Bag<Bag_red<int>, PBFSPhase,
+             walk_Filling<Bag_red<int>, PBFSPhase, pbfs_proc_Node>>(
+        *&queue[queuei], queue[!queuei], ph);
 #endif // REDUCER_IMPL
     queuei = !queuei;
     ++newdist;
   }
+  if (layerHook != NULL)
+    layerHook(layerHookArg, newdist - 1, 0);
 
   return 0;
 }
+
+// Per-worker state for pbfs_wls.  Padded to a cache line so that
+// workers do not falsely share their queue heads.
+struct alignas(64) wl_worker {
+  // Segments filled during the current layer; the head is being filled
+  wl_stack *out;
+  // Segments recycled from previous layers
+  wl_stack *free;
+};
+
+static inline void pbfs_wls_push(wl_worker workers[], unsigned int p,
+                                 unsigned int v) {
+  wl_worker &w = workers[p];
+  wl_stack *seg = w.out;
+
+  if (seg == NULL || seg->top == WL_SEG_SIZE) {
+    seg = w.free;
+    if (seg != NULL)
+      w.free = seg->next;
+    else
+      seg = new wl_stack;
+    seg->top = 0;
+    seg->owner = p;
+    seg->next = w.out;
+    w.out = seg;
+  }
+  seg->queue[seg->top++] = v;
+}
+
+static inline void pbfs_wls_proc_Node(const unsigned int n[], int fillSize,
+                                      wl_worker workers[], uint newdist,
+                                      uint distances[], const int nodes[],
+                                      const int edges[]) {
+  // The worker cannot change within this strand
+  unsigned int p = __cilkrts_get_worker_number();
+
+  for (int j = 0; j < fillSize; ++j) {
+    int edgeZero = nodes[n[j]];
+    int edgeLast = nodes[n[j] + 1];
+
+    for (int i = edgeZero; i < edgeLast; ++i) {
+      // Ignore races on distances[edge]
+      Cilksan_fake_lock_guard guard(&mtx);
+      int edge = edges[i];
+      if (newdist < distances[edge]) {
+        pbfs_wls_push(workers, p, edge);
+        distances[edge] = newdist;
+      }
+    }
+  }
+}
+
+int Graph::pbfs_wls(const int s, unsigned int distances[]) const {
+  if (s < 0 || s >= nNodes)
+    return -1;
+
+  int P = __cilkrts_get_nworkers();
+  wl_worker *workers = new wl_worker[P];
+  for (int p = 0; p < P; ++p) {
+    workers[p].out = NULL;
+    workers[p].free = NULL;
+  }
+
+  cilk_for(int i = 0; i < nNodes; ++i) distances[i] = UINT_MAX;
+
+  distances[s] = 0;
+
+  // Scan the edges of the initial node and add untouched
+  // neighbors to the workers' queues
+  cilk_for(int i = nodes[s]; i < nodes[s + 1]; ++i) {
+    if (edges[i] != s) {
+      pbfs_wls_push(workers, __cilkrts_get_worker_number(), edges[i]);
+      distances[edges[i]] = 1;
+    }
+  }
+  unsigned int newdist = 2;
+
+  std::vector<wl_stack *> segs;
+  while (true) {
+    // Gather the segments of every worker's queue, so that all workers
+    // can steal chunks of any queue
+    segs.clear();
+    for (int p = 0; p < P; ++p) {
+      for (wl_stack *seg = workers[p].out; seg != NULL; seg = seg->next)
+        segs.push_back(seg);
+      workers[p].out = NULL;
+    }
+    if (segs.empty())
+      break;
+
+    wl_stack **curr = segs.data();
+#pragma cilk grainsize 1
+    cilk_for(size_t k = 0; k < segs.size(); ++k) {
+      const wl_stack *seg = curr[k];
+      cilk_for(unsigned int i = 0; i < seg->top; i += THRESHOLD) {
+        pbfs_wls_proc_Node(seg->queue + i,
+                           std::min((unsigned int)THRESHOLD, seg->top - i),
+                           workers, newdist, distances, nodes, edges);
+      }
+    }
+
+    // Return the segments of this layer to their owners for reuse
+    for (size_t k = 0; k < segs.size(); ++k) {
+      wl_worker &w = workers[curr[k]->owner];
+      curr[k]->next = w.free;
+      w.free = curr[k];
+    }
+    ++newdist;
+  }
+
+  for (int p = 0; p < P; ++p) {
+    while (workers[p].free != NULL) {
+      wl_stack *seg = workers[p].free;
+      workers[p].free = seg->next;
+      delete seg;
+    }
+  }
+  delete[] workers;
+
+  return 0;
+}
+
+// Replace arr[0..n) with its exclusive prefix sums and return the total
+static int prefix_sum(int arr[], int n) {
+  int nblocks = (n + PREFIX_SUM_BLOCK - 1) / PREFIX_SUM_BLOCK;
+  int *sums = new int[nblocks + 1];
+
+  cilk_for(int b = 0; b < nblocks; ++b) {
+    int end = std::min(n, (b + 1) * PREFIX_SUM_BLOCK);
+    int sum = 0;
+    for (int i = b * PREFIX_SUM_BLOCK; i < end; ++i)
+      sum += arr[i];
+    sums[b] = sum;
+  }
+
+  int total = 0;
+  for (int b = 0; b < nblocks; ++b) {
+    int prev = sums[b];
+    sums[b] = total;
+    total += prev;
+  }
+
+  cilk_for(int b = 0; b < nblocks; ++b) {
+    int end = std::min(n, (b + 1) * PREFIX_SUM_BLOCK);
+    int sum = sums[b];
+    for (int i = b * PREFIX_SUM_BLOCK; i < end; ++i) {
+      int prev = arr[i];
+      arr[i] = sum;
+      sum += prev;
+    }
+  }
+
+  delete[] sums;
+  return total;
+}
+
+// Scan the edges of the nodes n[0..fillSize), writing the untouched
+// neighbors to out.  Returns the number of neighbors written.
+static inline int pbfs_compact_proc_Node(const int n[], int fillSize, int out[],
+                                         uint newdist, uint distances[],
+                                         const int nodes[],
+                                         const int edges[]) {
+  int count = 0;
+  for (int j = 0; j < fillSize; ++j) {
+    int edgeZero = nodes[n[j]];
+    int edgeLast = nodes[n[j] + 1];
+
+    for (int i = edgeZero; i < edgeLast; ++i) {
+      int edge = edges[i];
+      uint olddist = __atomic_load_n(&distances[edge], __ATOMIC_RELAXED);
+      // Claim edge atomically, so that each node enters the next
+      // frontier exactly once
+      if (newdist < olddist &&
+          __atomic_compare_exchange_n(&distances[edge], &olddist, newdist,
+                                      false, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED))
+        out[count++] = edge;
+    }
+  }
+  return count;
+}
+
+// Reserve space in scratch for the neighbors of each chunk of
+// THRESHOLD nodes of frontier[0..frontierSize), setting offset[c] to
+// chunk c's region.  Returns the total degree of the frontier.
+static int pbfs_compact_offsets(const int frontier[], int frontierSize,
+                                int offset[], const int nodes[]) {
+  int nchunks = (frontierSize + THRESHOLD - 1) / THRESHOLD;
+
+  cilk_for(int c = 0; c < nchunks; ++c) {
+    int end = std::min(frontierSize, (c + 1) * THRESHOLD);
+    int degree = 0;
+    for (int j = c * THRESHOLD; j < end; ++j)
+      degree += nodes[frontier[j] + 1] - nodes[frontier[j]];
+    offset[c] = degree;
+  }
+  return prefix_sum(offset, nchunks);
+}
+
+// Expand the frontier[0..frontierSize) into next, claiming each
+// undiscovered neighbor with newdist.  The offsets must come from
+// pbfs_compact_offsets.  Returns the size of next.
+static int pbfs_compact_layer(const int frontier[], int frontierSize,
+                              int next[], int scratch[], const int offset[],
+                              int count[], uint newdist, uint distances[],
+                              const int nodes[], const int edges[]) {
+  int nchunks = (frontierSize + THRESHOLD - 1) / THRESHOLD;
+
+  cilk_for(int c = 0; c < nchunks; ++c) {
+    int start = c * THRESHOLD;
+    int fillSize = std::min(frontierSize - start, THRESHOLD);
+    count[c] =
+        pbfs_compact_proc_Node(frontier + start, fillSize, scratch + offset[c],
+                               newdist, distances, nodes, edges);
+  }
+
+  // Compact the chunks' discoveries into the next frontier
+  int nextSize = prefix_sum(count, nchunks);
+  cilk_for(int c = 0; c < nchunks; ++c) {
+    int size = (c + 1 < nchunks ? count[c + 1] : nextSize) - count[c];
+    if (size > 0)
+      memcpy(next + count[c], scratch + offset[c], size * sizeof(int));
+  }
+
+  return nextSize;
+}
+
+int Graph::pbfs_compact(const int s, unsigned int distances[]) const {
+  if (s < 0 || s >= nNodes)
+    return -1;
+
+  // Each layer's frontier is a contiguous array.  Each chunk of
+  // THRESHOLD frontier nodes writes its discoveries into its own region
+  // of scratch, sized by the chunk's total degree, and prefix sums over
+  // the chunks' counts compact the regions into the next frontier.
+  int maxChunks = (nNodes + THRESHOLD - 1) / THRESHOLD;
+  int *frontier = new int[nNodes];
+  int *next = new int[nNodes];
+  int *scratch = new int[nEdges];
+  int *offset = new int[maxChunks];
+  int *count = new int[maxChunks];
+
+  cilk_for(int i = 0; i < nNodes; ++i) distances[i] = UINT_MAX;
+
+  distances[s] = 0;
+  frontier[0] = s;
+  int frontierSize = 1;
+  unsigned int newdist = 1;
+
+  while (frontierSize > 0) {
+    pbfs_compact_offsets(frontier, frontierSize, offset, nodes);
+    int nextSize =
+        pbfs_compact_layer(frontier, frontierSize, next, scratch, offset, count,
+                           newdist, distances, nodes, edges);
+
+    std::swap(frontier, next);
+    frontierSize = nextSize;
+    ++newdist;
+  }
+
+  delete[] frontier;
+  delete[] next;
+  delete[] scratch;
+  delete[] offset;
+  delete[] count;
+
+  return 0;
+}
+
+BFSWorkspace::BFSWorkspace(unsigned int nNodes) {
+  this->nNodes = nNodes;
+  this->distances = new unsigned int[nNodes];
+  cilk_for(int i = 0; i < nNodes; ++i) distances[i] = UINT_MAX;
+}
+
+BFSWorkspace::~BFSWorkspace() { delete[] this->distances; }
+
+int Graph::pbfs_bounded(const int s, unsigned int maxDepth,
+                        unsigned int maxVisited, BFSWorkspace &ws) const {
+  if (s < 0 || s >= nNodes)
+    return -1;
+  if (ws.nNodes != nNodes) {
+    fprintf(stderr, "BFSWorkspace has %u nodes, but the graph has %u\n",
+            ws.nNodes, nNodes);
+    return -1;
+  }
+
+  // Forget the previous search
+  std::vector<int> &visited = ws.visited;
+  unsigned int *distances = ws.distances;
+  cilk_for(size_t i = 0; i < visited.size(); ++i) {
+    distances[visited[i]] = UINT_MAX;
+  }
+  visited.clear();
+  if (maxVisited == 0)
+    return 0;
+
+  // The layers are expanded as in pbfs_compact, but the visited list
+  // holds them in order, so each frontier is the tail of the list and
+  // the next layer is appended to it.
+  distances[s] = 0;
+  visited.push_back(s);
+  size_t frontierStart = 0;
+  unsigned int newdist = 1;
+
+  while (frontierStart < visited.size() && newdist <= maxDepth &&
+         visited.size() < maxVisited) {
+    int frontierSize = visited.size() - frontierStart;
+    size_t nchunks = (frontierSize + THRESHOLD - 1) / THRESHOLD;
+    if (ws.offset.size() < nchunks) {
+      ws.offset.resize(nchunks);
+      ws.count.resize(nchunks);
+    }
+    int degree = pbfs_compact_offsets(visited.data() + frontierStart,
+                                      frontierSize, ws.offset.data(), nodes);
+    if (ws.scratch.size() < degree)
+      ws.scratch.resize(degree);
+
+    // The next layer holds at most the frontier's neighbors
+    size_t size = visited.size();
+    visited.resize(size + std::min((size_t)degree, nNodes - size));
+    int nextSize = pbfs_compact_layer(
+        visited.data() + frontierStart, frontierSize, visited.data() + size,
+        ws.scratch.data(), ws.offset.data(), ws.count.data(), newdist,
+        distances, nodes, edges);
+    visited.resize(size + nextSize);
+
+    frontierStart = size;
+    ++newdist;
+  }
+
+  // Drop the nodes of the last layer beyond the cap
+  if (visited.size() > maxVisited) {
+    cilk_for(size_t i = maxVisited; i < visited.size(); ++i) {
+      distances[visited[i]] = UINT_MAX;
+    }
+    visited.resize(maxVisited);
+  }
+
+  return 0;
+}
+
+BidirWorkspace::BidirWorkspace(unsigned int nNodes) {
+  this->nNodes = nNodes;
+  this->base = 1;
+  for (int d = 0; d < 2; ++d) {
+    this->distances[d] = new unsigned int[nNodes];
+    this->parents[d] = new int[nNodes];
+  }
+  cilk_for(int i = 0; i < nNodes; ++i) {
+    distances[0][i] = 0;
+    distances[1][i] = 0;
+  }
+}
+
+BidirWorkspace::~BidirWorkspace() {
+  for (int d = 0; d < 2; ++d) {
+    delete[] this->distances[d];
+    delete[] this->parents[d];
+  }
+}
+
+const unsigned long long BIDIR_NO_MEET = ~0ULL;
+
+// State shared by the walks of one layer of pbfs_bidir
+typedef struct {
+  // 0 to search forward from the source, 1 backward from the target
+  int side;
+  // The edges, distances and parents of this side
+  const int *nodes;
+  const int *edges;
+  unsigned int *distances;
+  int *parents;
+  // The distances of the other side
+  const unsigned int *other;
+  unsigned int base;
+  unsigned int newdist;
+  // An edge from a node found by the forward search to one found by the
+  // backward search, packed as from << 32 | to
+  unsigned long long *meet;
+} BidirPhase;
+
+static inline void bidir_proc_Node(const int n[], int fillSize,
+                                   Bag_array_red<int, 2> &next,
+                                   const BidirPhase &ph) {
+  // Stop early once the searches have met
+  if (__atomic_load_n(ph.meet, __ATOMIC_RELAXED) != BIDIR_NO_MEET)
+    return;
+
+  Bag_array<int, 2> &bags = *&next;
+  for (int j = 0; j < fillSize; ++j) {
+    int u = n[j];
+    for (int i = ph.nodes[u]; i < ph.nodes[u + 1]; ++i) {
+      int v = ph.edges[i];
+      uint old = __atomic_load_n(&ph.distances[v], __ATOMIC_RELAXED);
+      if (old < ph.base &&
+          __atomic_compare_exchange_n(&ph.distances[v], &old, ph.newdist,
+                                      false, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED)) {
+        ph.parents[v] = u;
+        bags.insert(ph.side, v);
+      }
+      if (ph.other[v] >= ph.base) {
+        unsigned long long none = BIDIR_NO_MEET;
+        unsigned long long edge =
+            ph.side == 0 ? (unsigned long long)u << 32 | (unsigned)v
+                         : (unsigned long long)v << 32 | (unsigned)u;
+        __atomic_compare_exchange_n(ph.meet, &none, edge, false,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+      }
+    }
+  }
+}
+
+// Bidirectional BFS: search forward from s and, over the parents index,
+// backward from t, each layer expanding the smaller frontier, until an
+// edge joins the two searches.  Every edge found in the layer where
+// they first meet lies on a shortest path.
+int Graph::pbfs_bidir(const int s, const int t, unsigned int *distance,
+                      std::vector<int> *path, BidirWorkspace &ws) const {
+  if (s < 0 || s >= nNodes || t < 0 || t >= nNodes)
+    return -1;
+  if (parents == NULL) {
+    fprintf(stderr, "PBFS_BIDIR requires Graph::indexParents\n");
+    return -1;
+  }
+  if (ws.nNodes != nNodes) {
+    fprintf(stderr, "BidirWorkspace has %u nodes, but the graph has %u\n",
+            ws.nNodes, nNodes);
+    return -1;
+  }
+
+  if (s == t) {
+    *distance = 0;
+    if (path != NULL)
+      path->assign(1, s);
+    return 0;
+  }
+
+  // Reset the distances only when the offsets could overflow
+  if (ws.base > UINT_MAX - nNodes) {
+    cilk_for(int i = 0; i < nNodes; ++i) {
+      ws.distances[0][i] = 0;
+      ws.distances[1][i] = 0;
+    }
+    ws.base = 1;
+  }
+  unsigned int base = ws.base;
+
+  const int *adjNodes[2] = {nodes, parentNodes};
+  const int *adjEdges[2] = {edges, parents};
+  int ends[2] = {s, t};
+  unsigned int depth[2] = {0, 0};
+  Bag<int> *frontier[2];
+  for (int d = 0; d < 2; ++d) {
+    ws.distances[d][ends[d]] = base;
+    ws.parents[d][ends[d]] = -1;
+    frontier[d] = new Bag<int>;
+    frontier[d]->insert(ends[d]);
+  }
+
+  Bag_array_red<int, 2> next;
+  unsigned long long meet = BIDIR_NO_MEET;
+  while (meet == BIDIR_NO_MEET && !frontier[0]->isEmpty() &&
+         !frontier[1]->isEmpty()) {
+    int d = frontier[1]->numElements() < frontier[0]->numElements();
+    BidirPhase ph = {d,
+                     adjNodes[d],
+                     adjEdges[d],
+                     ws.distances[d],
+                     ws.parents[d],
+                     ws.distances[!d],
+                     base,
+                     base + depth[d] + 1,
+                     &meet};
+    walk_Bag<Bag_array_red<int, 2>, BidirPhase,
+             walk_Filling<Bag_array_red<int, 2>, BidirPhase, bidir_proc_Node>>(
+        *frontier[d], next, ph);
+    delete frontier[d];
+    frontier[d] = next.take(d);
+    if (frontier[d] == NULL)
+      frontier[d] = new Bag<int>;
+    ++depth[d];
+  }
+  delete frontier[0];
+  delete frontier[1];
+  ws.base = base + std::max(depth[0], depth[1]) + 1;
+
+  if (meet == BIDIR_NO_MEET) {
+    *distance = UINT_MAX;
+    if (path != NULL)
+      path->clear();
+    return 0;
+  }
+
+  int from = meet >> 32, to = meet & 0xffffffff;
+  *distance = ws.distances[0][from] - base + 1 + ws.distances[1][to] - base;
+  if (path != NULL) {
+    path->clear();
+    for (int v = from; v != -1; v = ws.parents[0][v])
+      path->push_back(v);
+    std::reverse(path->begin(), path->end());
+    for (int v = to; v != -1; v = ws.parents[1][v])
+      path->push_back(v);
+  }
+
+  return 0;
+}
+
+MSBFSWorkspace::MSBFSWorkspace(unsigned int nNodes) {
+  this->nNodes = nNodes;
+  this->seen = new unsigned long long[nNodes];
+  this->next = new unsigned long long[nNodes];
+  cilk_for(int i = 0; i < nNodes; ++i) {
+    seen[i] = 0;
+    next[i] = 0;
+  }
+}
+
+MSBFSWorkspace::~MSBFSWorkspace() {
+  delete[] this->seen;
+  delete[] this->next;
+}
+
+// Scan the edges of the nodes n[0..fillSize), passing each node's
+// sources m[j] on to its neighbors, and writing the neighbors that
+// gain their first source of this layer to out.  Returns the number of
+// neighbors written.
+static inline int msbfs_proc_Node(const int n[], const unsigned long long m[],
+                                  int fillSize, int out[],
+                                  const unsigned long long seen[],
+                                  unsigned long long next[], const int nodes[],
+                                  const int edges[]) {
+  int count = 0;
+  for (int j = 0; j < fillSize; ++j) {
+    for (int i = nodes[n[j]]; i < nodes[n[j] + 1]; ++i) {
+      int v = edges[i];
+      unsigned long long bits = m[j] & ~seen[v];
+      // Skip the atomic when v already has these sources
+      if (bits == 0 ||
+          (bits & ~__atomic_load_n(&next[v], __ATOMIC_RELAXED)) == 0)
+        continue;
+      if (__atomic_fetch_or(&next[v], bits, __ATOMIC_RELAXED) == 0)
+        out[count++] = v;
+    }
+  }
+  return count;
+}
+
+// Multi-source BFS: each node carries a word with a bit for each source,
+// so that one scan of a node's edges serves all the sources that reach
+// it in the same layer.  The layers are expanded as in pbfs_compact.
+int Graph::msbfs(const int s[], int count, unsigned int maxDepth,
+                 MSBFSWorkspace &ws) const {
+  if (count < 1 || count > MSBFS_MAX_SOURCES)
+    return -1;
+  for (int i = 0; i < count; ++i)
+    if (s[i] < 0 || s[i] >= nNodes)
+      return -1;
+  if (ws.nNodes != nNodes) {
+    fprintf(stderr, "MSBFSWorkspace has %u nodes, but the graph has %u\n",
+            ws.nNodes, nNodes);
+    return -1;
+  }
+
+  // Forget the previous search
+  std::vector<int> &reached = ws.reached;
+  std::vector<unsigned long long> &masks = ws.masks;
+  cilk_for(size_t i = 0; i < reached.size(); ++i) {
+    ws.seen[reached[i]] = 0;
+  }
+  reached.clear();
+  masks.clear();
+  ws.layers.clear();
+
+  for (int i = 0; i < count; ++i) {
+    if (ws.seen[s[i]] == 0)
+      reached.push_back(s[i]);
+    ws.seen[s[i]] |= 1ULL << i;
+  }
+  for (size_t j = 0; j < reached.size(); ++j)
+    masks.push_back(ws.seen[reached[j]]);
+  ws.layers.push_back(0);
+  ws.layers.push_back(reached.size());
+
+  for (unsigned int depth = 0;
+       depth < maxDepth && ws.layers[depth + 1] > ws.layers[depth]; ++depth) {
+    size_t start = ws.layers[depth], size = reached.size();
+    int frontierSize = size - start;
+    size_t nchunks = (frontierSize + THRESHOLD - 1) / THRESHOLD;
+    if (ws.offset.size() < nchunks) {
+      ws.offset.resize(nchunks);
+      ws.count.resize(nchunks);
+    }
+    int degree = pbfs_compact_offsets(reached.data() + start, frontierSize,
+                                      ws.offset.data(), nodes);
+    if (ws.scratch.size() < degree)
+      ws.scratch.resize(degree);
+
+    const int *frontier = reached.data() + start;
+    const unsigned long long *frontierMasks = masks.data() + start;
+    int *scratch = ws.scratch.data();
+    int *offset = ws.offset.data();
+    int *counts = ws.count.data();
+    cilk_for(int c = 0; c < nchunks; ++c) {
+      int first = c * THRESHOLD;
+      counts[c] = msbfs_proc_Node(
+          frontier + first, frontierMasks + first,
+          std::min(frontierSize - first, THRESHOLD), scratch + offset[c],
+          ws.seen, ws.next, nodes, edges);
+    }
+
+    // Compact the chunks' discoveries into the next layer, and move
+    // their sources from next to seen
+    int nextSize = prefix_sum(counts, nchunks);
+    reached.resize(size + nextSize);
+    masks.resize(size + nextSize);
+    int *out = reached.data() + size;
+    cilk_for(int c = 0; c < nchunks; ++c) {
+      int n = (c + 1 < nchunks ? counts[c + 1] : nextSize) - counts[c];
+      memcpy(out + counts[c], scratch + offset[c], n * sizeof(int));
+    }
+    unsigned long long *outMasks = masks.data() + size;
+    cilk_for(int j = 0; j < nextSize; ++j) {
+      int v = out[j];
+      outMasks[j] = ws.next[v];
+      ws.seen[v] |= ws.next[v];
+      ws.next[v] = 0;
+    }
+    ws.layers.push_back(size + nextSize);
+  }
+
+  return 0;
+}
+
+// Scan the parents of each undiscovered node in [start, end) for one in
+// the frontier, stopping at the first found.  Returns the number of
+// nodes discovered, and sets *degree to the sum of their degrees.
+static inline int pbfs_do_proc_Block(int start, int end,
+                                     const unsigned char front[],
+                                     unsigned char next[], uint newdist,
+                                     uint distances[], const int nodes[],
+                                     const int parentNodes[],
+                                     const int parents[], long *degree) {
+  int count = 0;
+  long deg = 0;
+  for (int v = start; v < end; ++v) {
+    next[v] = 0;
+    if (distances[v] != UINT_MAX)
+      continue;
+    for (int i = parentNodes[v]; i < parentNodes[v + 1]; ++i) {
+      if (front[parents[i]]) {
+        distances[v] = newdist;
+        next[v] = 1;
+        ++count;
+        deg += nodes[v + 1] - nodes[v];
+        break;
+      }
+    }
+  }
+  *degree = deg;
+  return count;
+}
+
+int Graph::pbfs_do(const int s, unsigned int distances[]) const {
+  if (s < 0 || s >= nNodes)
+    return -1;
+  if (parents == NULL) {
+    fprintf(stderr, "PBFS_DO requires Graph::indexParents\n");
+    return -1;
+  }
+
+  // Layers start top-down, as in pbfs_compact.  A large frontier is
+  // instead stored as a byte map, and each undiscovered node searches
+  // its parents for one in the frontier.
+  int maxChunks = (nNodes + THRESHOLD - 1) / THRESHOLD;
+  int nblocks = (nNodes + BOTTOM_UP_BLOCK - 1) / BOTTOM_UP_BLOCK;
+  int *frontier = new int[nNodes];
+  int *next = new int[nNodes];
+  int *scratch = new int[nEdges];
+  int *offset = new int[std::max(maxChunks, nblocks)];
+  int *count = new int[std::max(maxChunks, nblocks)];
+  long *degree = new long[std::max(maxChunks, nblocks)];
+  unsigned char *front = new unsigned char[nNodes];
+  unsigned char *nextFront = new unsigned char[nNodes];
+
+  cilk_for(int i = 0; i < nNodes; ++i) distances[i] = UINT_MAX;
+
+  distances[s] = 0;
+  frontier[0] = s;
+  int frontierSize = 1;
+  long frontierDegree = nodes[s + 1] - nodes[s];
+  long unexplored = nEdges;
+  bool bottomUp = false;
+  unsigned int newdist = 1;
+
+  while (frontierSize > 0) {
+    if (!bottomUp && frontierDegree > unexplored / DO_ALPHA) {
+      cilk_for(int i = 0; i < nNodes; ++i) front[i] = 0;
+      cilk_for(int j = 0; j < frontierSize; ++j) front[frontier[j]] = 1;
+      bottomUp = true;
+    } else if (bottomUp && frontierSize < nNodes / DO_BETA) {
+      // Gather the byte map back into a contiguous frontier
+      cilk_for(int b = 0; b < nblocks; ++b) {
+        int end = std::min((int)nNodes, (b + 1) * BOTTOM_UP_BLOCK);
+        int c = 0;
+        for (int v = b * BOTTOM_UP_BLOCK; v < end; ++v)
+          c += front[v];
+        count[b] = c;
+      }
+      prefix_sum(count, nblocks);
+      cilk_for(int b = 0; b < nblocks; ++b) {
+        int end = std::min((int)nNodes, (b + 1) * BOTTOM_UP_BLOCK);
+        int j = count[b];
+        for (int v = b * BOTTOM_UP_BLOCK; v < end; ++v)
+          if (front[v])
+            frontier[j++] = v;
+      }
+      bottomUp = false;
+    }
+    unexplored -= frontierDegree;
+
+    if (bottomUp) {
+      cilk_for(int b = 0; b < nblocks; ++b) {
+        int end = std::min((int)nNodes, (b + 1) * BOTTOM_UP_BLOCK);
+        count[b] = pbfs_do_proc_Block(b * BOTTOM_UP_BLOCK, end, front,
+                                      nextFront, newdist, distances, nodes,
+                                      parentNodes, parents, &degree[b]);
+      }
+      frontierSize = 0;
+      frontierDegree = 0;
+      for (int b = 0; b < nblocks; ++b) {
+        frontierSize += count[b];
+        frontierDegree += degree[b];
+      }
+      std::swap(front, nextFront);
+    } else {
+      pbfs_compact_offsets(frontier, frontierSize, offset, nodes);
+      frontierSize =
+          pbfs_compact_layer(frontier, frontierSize, next, scratch, offset,
+                             count, newdist, distances, nodes, edges);
+      std::swap(frontier, next);
+
+      int nchunks = (frontierSize + THRESHOLD - 1) / THRESHOLD;
+      cilk_for(int c = 0; c < nchunks; ++c) {
+        int end = std::min(frontierSize, (c + 1) * THRESHOLD);
+        long d = 0;
+        for (int j = c * THRESHOLD; j < end; ++j)
+          d += nodes[frontier[j] + 1] - nodes[frontier[j]];
+        degree[c] = d;
+      }
+      frontierDegree = 0;
+      for (int c = 0; c < nchunks; ++c)
+        frontierDegree += degree[c];
+    }
+    ++newdist;
+  }
+
+  delete[] frontier;
+  delete[] next;
+  delete[] scratch;
+  delete[] offset;
+  delete[] count;
+  delete[] degree;
+  delete[] front;
+  delete[] nextFront;
+
+  return 0;
+}
+
+// Set deg[j] to the number of edges of the nodes n[0..j), for j in
+// [0, fillSize]: a local sum over each THRESHOLD nodes, then a pass that
+// carries the sums across.
+static void balanced_degrees(const int n[], int fillSize, int deg[],
+                             const int nodes[]) {
+  int nchunks = (fillSize + THRESHOLD - 1) / THRESHOLD;
+  deg[0] = 0;
+  cilk_for(int c = 0; c < nchunks; ++c) {
+    int end = std::min(fillSize, (c + 1) * THRESHOLD);
+    int sum = 0;
+    for (int j = c * THRESHOLD; j < end; ++j) {
+      sum += nodes[n[j] + 1] - nodes[n[j]];
+      deg[j + 1] = sum;
+    }
+  }
+  for (int c = 1; c < nchunks; ++c)
+    deg[std::min(fillSize, (c + 1) * THRESHOLD)] += deg[c * THRESHOLD];
+  cilk_for(int c = 1; c < nchunks; ++c) {
+    int end = std::min(fillSize, (c + 1) * THRESHOLD);
+    for (int j = c * THRESHOLD + 1; j < end; ++j)
+      deg[j] += deg[c * THRESHOLD];
+  }
+}
+
+// Scan the edges edges[first..last) of a single node
+static void balanced_proc_Edges(int first, int last, Bag_red<int> &next,
+                                const PBFSPhase &ph) {
+  Bag<int> &bnext = *&next;
+  for (int i = first; i < last; ++i) {
+    // Ignore races on distances[edge]
+    Cilksan_fake_lock_guard guard(&mtx);
+    int edge = ph.edges[i];
+    if (ph.newdist < ph.distances[edge]) {
+      bnext.insert(edge);
+      ph.distances[edge] = ph.newdist;
+    }
+  }
+}
+
+// Scan the nodes n[lo..hi), whose edges deg[] counts, splitting them
+// into leaves of at most BALANCED_GRAIN edges and THRESHOLD nodes.  The
+// edges of a node with more than BALANCED_GRAIN edges are split too.
+static void balanced_walk_Range(const int n[], const int deg[], int lo,
+                                int hi, Bag_red<int> &next,
+                                const PBFSPhase &ph) {
+  int nedges = deg[hi] - deg[lo];
+  if (hi - lo == 1 && nedges > BALANCED_GRAIN) {
+    int first = ph.nodes[n[lo]];
+    cilk_for(int i = 0; i < nedges; i += BALANCED_GRAIN) {
+      int last = first + std::min(nedges, i + BALANCED_GRAIN);
+      balanced_proc_Edges(first + i, last, next, ph);
+    }
+    return;
+  }
+  if (hi - lo == 1 || (nedges <= BALANCED_GRAIN && hi - lo <= THRESHOLD)) {
+    pbfs_proc_Node(n + lo, hi - lo, next, ph);
+    return;
+  }
+
+  // Split at the median edge, or at the middle node if few edges remain
+  int mid;
+  if (nedges <= BALANCED_GRAIN) {
+    mid = lo + (hi - lo) / 2;
+  } else {
+    // A last node with over half the edges is split off on its own
+    mid = std::lower_bound(deg + lo + 1, deg + hi - 1,
+                           deg[lo] + nedges / 2) - deg;
+  }
+  cilk_spawn balanced_walk_Range(n, deg, lo, mid, next, ph);
+  balanced_walk_Range(n, deg, mid, hi, next, ph);
+}
+
+// Walk a block of the frontier, for walk_Bag
+static void balanced_walk_Filling(const int n[], int fillSize,
+                                  Bag_red<int> &next, const PBFSPhase &ph) {
+  if (fillSize == 0)
+    return;
+  // On the heap: the array stays live across the whole recursion, and
+  // BLK_SIZE entries would be too many for a fiber's stack
+  std::vector<int> deg(fillSize + 1);
+  balanced_degrees(n, fillSize, deg.data(), ph.nodes);
+  balanced_walk_Range(n, deg.data(), 0, fillSize, next, ph);
+}
+
+// PBFS with leaves balanced by edge count rather than node count.  Each
+// block of the frontier is split at the median of its nodes' edges, and
+// the edges of a high-degree node, including the source, are split
+// among several leaves, so that a hub does not set the span of a layer.
+int Graph::pbfs_balanced(const int s, unsigned int distances[]) const {
+  if (s < 0 || s >= nNodes)
+    return -1;
+
+  Bag_red<int> b1;
+  Bag_red<int> b2;
+  Bag_red<int> *queue[2] = {__builtin_addressof(b1), __builtin_addressof(b2)};
+  bool queuei = 0;
+
+  cilk_for(int i = 0; i < nNodes; ++i) distances[i] = UINT_MAX;
+
+  // Start from the source alone, so that its edges are split as well
+  distances[s] = 0;
+  queue[queuei]->insert(s);
+  PBFSPhase ph = {nodes, edges, distances, 1};
+
+  while (!queue[queuei]->isEmpty()) {
+    if (layerHook != NULL)
+      layerHook(layerHookArg, ph.newdist - 1, queue[queuei]->numElements());
+    queue[!queuei]->clear();
+    walk_Bag<Bag_red<int>, PBFSPhase, balanced_walk_Filling>(
+        *queue[queuei], *queue[!queuei], ph);
+    queuei = !queuei;
+    ++ph.newdist;
+  }
+  if (layerHook != NULL)
+    layerHook(layerHookArg, ph.newdist - 1, 0);
+
+  return 0;
+}
+
+// Serial Dijkstra's algorithm, for checking sssp
+int Graph::dijkstra(const int s, double distances[]) const {
+  if (s < 0 || s >= nNodes)
+    return -1;
+
+  for (int i = 0; i < nNodes; ++i)
+    distances[i] = INFINITY;
+  distances[s] = 0;
+
+  typedef std::pair<double, int> Entry;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+  heap.push(Entry(0, s));
+  while (!heap.empty()) {
+    Entry top = heap.top();
+    heap.pop();
+    int u = top.second;
+    if (top.first > distances[u])
+      continue;
+    for (int i = nodes[u]; i < nodes[u + 1]; ++i) {
+      double d = top.first + (weights ? weights[i] : 1.0);
+      if (d < distances[edges[i]]) {
+        distances[edges[i]] = d;
+        heap.push(Entry(d, edges[i]));
+      }
+    }
+  }
+
+  return 0;
+}
+
+// The delta-stepping buckets, kept in a cyclic window of SSSP_BUCKETS,
+// plus a bag of the nodes settled from the current bucket
+typedef Bag_array<int, SSSP_BUCKETS + 1> SSSPBags;
+typedef Bag_array_red<int, SSSP_BUCKETS + 1> SSSPBags_red;
+const int SSSP_SETTLED = SSSP_BUCKETS;
+
+// State shared by the walks of one delta-stepping phase
+typedef struct {
+  const int *nodes;
+  const int *edges;
+  const double *weights;
+  double *distances;
+  // The distance at which each node last relaxed its light and heavy
+  // edges
+  double *lightDone;
+  double *heavyDone;
+  double delta;
+  long current;
+  bool heavy;
+} SSSPPhase;
+
+// Lower distances[v] to d, if that is smaller, and put v in its bucket
+static inline void sssp_relax(const SSSPPhase &ph, SSSPBags &bags, int v,
+                              double d) {
+  double old;
+  __atomic_load(&ph.distances[v], &old, __ATOMIC_RELAXED);
+  while (d < old) {
+    if (__atomic_compare_exchange(&ph.distances[v], &old, &d, false,
+                                  __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      bags.insert((long)(d / ph.delta) % SSSP_BUCKETS, v);
+      return;
+    }
+  }
+}
+
+// Claim node u for relaxation at distance d, unless it already relaxed
+// its edges at a distance no greater than d
+static inline bool sssp_claim(double done[], int u, double d) {
+  double old;
+  __atomic_load(&done[u], &old, __ATOMIC_RELAXED);
+  while (d < old) {
+    if (__atomic_compare_exchange(&done[u], &old, &d, false, __ATOMIC_RELAXED,
+                                  __ATOMIC_RELAXED))
+      return true;
+  }
+  return false;
+}
+
+static inline void sssp_proc_Node(const int n[], int fillSize,
+                                  SSSPBags_red &next, const SSSPPhase &ph) {
+  SSSPBags &bags = *&next;
+  for (int j = 0; j < fillSize; ++j) {
+    int u = n[j];
+    double d;
+    __atomic_load(&ph.distances[u], &d, __ATOMIC_RELAXED);
+    if (ph.heavy) {
+      if (!sssp_claim(ph.heavyDone, u, d))
+        continue;
+    } else {
+      // Skip stale entries, for nodes since moved to a lower bucket
+      if ((long)(d / ph.delta) != ph.current ||
+          !sssp_claim(ph.lightDone, u, d))
+        continue;
+      bags.insert(SSSP_SETTLED, u);
+    }
+
+    for (int i = ph.nodes[u]; i < ph.nodes[u + 1]; ++i) {
+      double w = ph.weights ? ph.weights[i] : 1.0;
+      if ((w > ph.delta) == ph.heavy)
+        sssp_relax(ph, bags, ph.edges[i], d + w);
+    }
+  }
+}
+
+// Delta-stepping: nodes are kept in buckets of width delta by tentative
+// distance.  The lowest nonempty bucket is emptied by repeatedly
+// relaxing the light edges, of weight at most delta, of the nodes in it;
+// then the heavy edges of the nodes settled from it are relaxed once.
+// A delta of 0 or less picks the average edge weight.
+int Graph::sssp(const int s, double distances[], double delta) const {
+  if (s < 0 || s >= nNodes)
+    return -1;
+
+  // Find the average, least and greatest weights
+  double sum = nEdges, minWeight = 1, maxWeight = 1;
+  if (weights != NULL) {
+    int nblocks = (nEdges + PREFIX_SUM_BLOCK - 1) / PREFIX_SUM_BLOCK;
+    double *blockSum = new double[3 * nblocks];
+    cilk_for(int b = 0; b < nblocks; ++b) {
+      int end = std::min((int)nEdges, (b + 1) * PREFIX_SUM_BLOCK);
+      double bs = 0, bmin = INFINITY, bmax = 0;
+      for (int i = b * PREFIX_SUM_BLOCK; i < end; ++i) {
+        bs += weights[i];
+        bmin = std::min(bmin, weights[i]);
+        bmax = std::max(bmax, weights[i]);
+      }
+      blockSum[3 * b] = bs;
+      blockSum[3 * b + 1] = bmin;
+      blockSum[3 * b + 2] = bmax;
+    }
+    sum = 0;
+    minWeight = INFINITY;
+    maxWeight = 0;
+    for (int b = 0; b < nblocks; ++b) {
+      sum += blockSum[3 * b];
+      minWeight = std::min(minWeight, blockSum[3 * b + 1]);
+      maxWeight = std::max(maxWeight, blockSum[3 * b + 2]);
+    }
+    delete[] blockSum;
+  }
+  if (minWeight < 0) {
+    fprintf(stderr, "SSSP requires nonnegative edge weights\n");
+    return -1;
+  }
+  bool given = delta > 0;
+  if (!given)
+    delta = nEdges > 0 ? sum / nEdges : 1;
+  // Relaxing an edge must not reach past the window of buckets
+  double minDelta = maxWeight / (SSSP_BUCKETS - 2);
+  if (given && delta < minDelta)
+    fprintf(stderr,
+            "Raising delta from %g to %g, so that the heaviest edge "
+            "spans at most %d buckets\n",
+            delta, minDelta, SSSP_BUCKETS - 2);
+  delta = std::max(delta, minDelta);
+  if (delta <= 0)
+    delta = 1;
+
+  double *lightDone = new double[nNodes];
+  double *heavyDone = new double[nNodes];
+  cilk_for(int i = 0; i < nNodes; ++i) {
+    distances[i] = INFINITY;
+    lightDone[i] = INFINITY;
+    heavyDone[i] = INFINITY;
+  }
+
+  SSSPBags_red bags;
+  distances[s] = 0;
+  bags.insert(0, s);
+
+  SSSPPhase ph = {nodes,     edges, weights, distances, lightDone,
+                  heavyDone, delta, 0,       false};
+  while (true) {
+    int k = 0;
+    while (k < SSSP_BUCKETS && bags.isEmpty((ph.current + k) % SSSP_BUCKETS))
+      ++k;
+    if (k == SSSP_BUCKETS)
+      break;
+    ph.current += k;
+    int b = ph.current % SSSP_BUCKETS;
+
+    // Light phases, until the bucket stays empty
+    ph.heavy = false;
+    while (!bags.isEmpty(b)) {
+      Bag<int> *frontier = bags.take(b);
+      walk_Bag<SSSPBags_red, SSSPPhase,
+               walk_Filling<SSSPBags_red, SSSPPhase, sssp_proc_Node>>(
+          *frontier, bags, ph);
+      delete frontier;
+    }
+
+    // Heavy phase
+    ph.heavy = true;
+    Bag<int> *settled = bags.take(SSSP_SETTLED);
+    if (settled != NULL) {
+      walk_Bag<SSSPBags_red, SSSPPhase,
+               walk_Filling<SSSPBags_red, SSSPPhase, sssp_proc_Node>>(
+          *settled, bags, ph);
+      delete settled;
+    }
+    ++ph.current;
+  }
+
+  delete[] lightDone;
+  delete[] heavyDone;
+
+  return 0;
+}
+
+// Remove self loops and duplicate neighbors if requested, and then, if
+// requested, add the reverse of each edge that has none.  Each vertex's
+// neighbors stay sorted.
+SimplifyStats Graph::simplify(bool symmetrize, bool noSelfLoops,
+                              bool noDuplicates) {
+  SimplifyStats stats = {0, 0, 0};
+  int n = nNodes;
+
+  // The edges are compacted in place, so a graph that does not own its
+  // arrays first copies them
+  if (ownership != GRAPH_OWNED)
+    copyArrays();
+  int *degree = new int[n];
+  int *extra = new int[n + 1];
+
+  cilk_for(int u = 0; u < n; ++u) {
+    // Compact the neighbors that remain to the front of the list.  Of
+    // duplicate edges, the lightest weight is kept.
+    int out = nodes[u];
+    unsigned int loops = 0, dups = 0;
+    for (int i = nodes[u]; i < nodes[u + 1]; ++i) {
+      if (noSelfLoops && edges[i] == u) {
+        ++loops;
+      } else if (noDuplicates && out > nodes[u] && edges[out - 1] == edges[i]) {
+        if (weights)
+          weights[out - 1] = std::min(weights[out - 1], weights[i]);
+        ++dups;
+      } else {
+        if (weights)
+          weights[out] = weights[i];
+        edges[out++] = edges[i];
+      }
+    }
+    degree[u] = out - nodes[u];
+    extra[u] = 0;
+    if (loops > 0)
+      __atomic_fetch_add(&stats.selfLoops, loops, __ATOMIC_RELAXED);
+    if (dups > 0)
+      __atomic_fetch_add(&stats.duplicates, dups, __ATOMIC_RELAXED);
+  }
+
+  // Count the reverse edges missing from each vertex's list
+  if (symmetrize) {
+    cilk_for(int u = 0; u < n; ++u) {
+      int *begin = edges + nodes[u], *end = begin + degree[u];
+      for (int *e = begin; e < end; ++e) {
+        int v = *e;
+        if ((e > begin && e[-1] == v) || v == u)
+          continue;
+        if (!std::binary_search(edges + nodes[v], edges + nodes[v] + degree[v],
+                                u))
+          __atomic_fetch_add(&extra[v], 1, __ATOMIC_RELAXED);
+      }
+    }
+  }
+
+  int *newNodes = new int[n + 1];
+  cilk_for(int u = 0; u < n; ++u) newNodes[u] = degree[u] + extra[u];
+  newNodes[n] = prefix_sum(newNodes, n);
+  int *newEdges = new int[newNodes[n]];
+  double *newWeights = weights ? new double[newNodes[n]] : NULL;
+
+  // extra[u] becomes the position of u's next added edge
+  cilk_for(int u = 0; u < n; ++u) {
+    memcpy(newEdges + newNodes[u], edges + nodes[u], degree[u] * sizeof(int));
+    if (weights)
+      memcpy(newWeights + newNodes[u], weights + nodes[u],
+             degree[u] * sizeof(double));
+    extra[u] = newNodes[u] + degree[u];
+  }
+
+  if (symmetrize) {
+    cilk_for(int u = 0; u < n; ++u) {
+      int *begin = edges + nodes[u], *end = begin + degree[u];
+      for (int *e = begin; e < end; ++e) {
+        int v = *e;
+        if ((e > begin && e[-1] == v) || v == u)
+          continue;
+        if (!std::binary_search(edges + nodes[v], edges + nodes[v] + degree[v],
+                                u)) {
+          int pos = __atomic_fetch_add(&extra[v], 1, __ATOMIC_RELAXED);
+          newEdges[pos] = u;
+          if (weights)
+            newWeights[pos] = weights[e - edges];
+        }
+      }
+    }
+    cilk_for(int u = 0; u < n; ++u) {
+      if (newNodes[u] + degree[u] < newNodes[u + 1])
+        sort_neighbors(newEdges, newWeights, newNodes[u], newNodes[u + 1]);
+    }
+  }
+
+  stats.added = newNodes[n] - (nEdges - stats.selfLoops - stats.duplicates);
+
+  delete[] degree;
+  delete[] extra;
+  delete[] this->nodes;
+  delete[] this->edges;
+  delete[] this->weights;
+  this->nodes = newNodes;
+  this->edges = newEdges;
+  this->weights = newWeights;
+  this->nEdges = newNodes[n];
+
+  // The parents index no longer matches the edges
+  delete[] this->parentNodes;
+  delete[] this->parents;
+  this->parentNodes = NULL;
+  this->parents = NULL;
+
+  return stats;
+}
+
+// Build the index of each node's parents, its in-neighbors, used by
+// bottom-up search.  Parents of higher degree come first, since they
+// are the likeliest to be in a large frontier.
+void Graph::indexParents() {
+  if (parents != NULL)
+    return;
+
+  int n = nNodes;
+  parentNodes = new int[n + 1];
+  parents = new int[nEdges];
+  cilk_for(int v = 0; v < n; ++v) parentNodes[v] = 0;
+  cilk_for(int i = 0; i < nEdges; ++i)
+      __atomic_fetch_add(&parentNodes[edges[i]], 1, __ATOMIC_RELAXED);
+  parentNodes[n] = prefix_sum(parentNodes, n);
+
+  int *w = new int[n];
+  cilk_for(int v = 0; v < n; ++v) w[v] = parentNodes[v];
+  cilk_for(int u = 0; u < n; ++u) {
+    for (int i = nodes[u]; i < nodes[u + 1]; ++i)
+      parents[__atomic_fetch_add(&w[edges[i]], 1, __ATOMIC_RELAXED)] = u;
+  }
+  delete[] w;
+
+  const int *nodes = this->nodes;
+  cilk_for(int v = 0; v < n; ++v) {
+    std::sort(parents + parentNodes[v], parents + parentNodes[v + 1],
+              [nodes](int a, int b) {
+                int da = nodes[a + 1] - nodes[a], db = nodes[b + 1] - nodes[b];
+                return da != db ? da > db : a < b;
+              });
+  }
+}
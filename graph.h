@@ -25,16 +25,130 @@
 #define GRAPH_H
 
 #include "bag.h"
+#include <algorithm>
 #include <cilk/cilk.h>
 #include <sys/types.h>
 #include <time.h>
 #include <vector>
 
+// Number of vertices in each segment of a pbfs_wls worker queue
+const unsigned int WL_SEG_SIZE = 2048;
+
 typedef struct wl_stack wl_stack;
 
+// Segment of a per-worker queue used by pbfs_wls.  Each worker pushes
+// onto its own list of segments, so a worker holds memory in
+// proportion to the vertices it discovers, rather than nNodes.
 struct wl_stack {
-  unsigned int top[2];
-  unsigned int queue[0];
+  unsigned int top;
+  unsigned int owner;
+  wl_stack *next;
+  unsigned int queue[WL_SEG_SIZE];
+};
+
+// Called at the start of each layer of a search with the distance and
+// size of its frontier, and once after the last layer with a size of 0
+typedef void (*LayerHook)(void *arg, unsigned int depth, size_t frontierSize);
+
+// Who frees the CSR arrays that a Graph wraps
+enum GraphOwnership {
+  // The graph frees them with delete[]
+  GRAPH_OWNED,
+  // The caller keeps them alive while the graph is in use, and frees them
+  GRAPH_BORROWED,
+  // They lie in a memory mapping, which the graph unmaps
+  GRAPH_MAPPED
+};
+
+// Edges changed by Graph::simplify
+typedef struct {
+  // Reverse edges added to symmetrize the graph
+  unsigned int added;
+  // Self loops removed
+  unsigned int selfLoops;
+  // Duplicate edges removed
+  unsigned int duplicates;
+} SimplifyStats;
+
+// Reusable state for Graph::pbfs_bounded.  The distances are allocated
+// once, and each search resets only the entries the previous search
+// set, so a search touches memory in proportion to the nodes it visits.
+class BFSWorkspace {
+  friend class Graph;
+
+private:
+  unsigned int nNodes;
+  unsigned int *distances;
+  // Visited nodes in order of distance
+  std::vector<int> visited;
+  std::vector<int> scratch;
+  std::vector<int> offset;
+  std::vector<int> count;
+
+public:
+  BFSWorkspace(unsigned int nNodes);
+  ~BFSWorkspace();
+
+  // Results of the last search, valid until the next one.  Nodes that
+  // were not visited have distance UINT_MAX.
+  inline const std::vector<int> &getVisited() const { return visited; }
+  inline const unsigned int *getDistances() const { return distances; }
+};
+
+// Reusable state for Graph::pbfs_bidir.  Each search stores distances
+// offset by a base above every value that earlier searches stored, so
+// the arrays need not be reset between searches.
+class BidirWorkspace {
+  friend class Graph;
+
+private:
+  unsigned int nNodes;
+  unsigned int base;
+  // Offset distances from the source and to the target
+  unsigned int *distances[2];
+  // The node each node was discovered from, in each search direction
+  int *parents[2];
+
+public:
+  BidirWorkspace(unsigned int nNodes);
+  ~BidirWorkspace();
+};
+
+// Number of sources that one Graph::msbfs can search from
+const int MSBFS_MAX_SOURCES = 64;
+
+// Reusable state for Graph::msbfs.  Bit i of a node's words is for the
+// i-th source.  Each search resets only the words of the nodes that the
+// previous search reached.
+class MSBFSWorkspace {
+  friend class Graph;
+
+private:
+  unsigned int nNodes;
+  // Sources that have reached each node
+  unsigned long long *seen;
+  // Sources that reach each node in the next layer
+  unsigned long long *next;
+  // Nodes reached, in order of distance, with the sources that first
+  // reached each one at that distance
+  std::vector<int> reached;
+  std::vector<unsigned long long> masks;
+  // Start of each layer in reached, followed by the end of the last
+  std::vector<size_t> layers;
+  std::vector<int> scratch;
+  std::vector<int> offset;
+  std::vector<int> count;
+
+public:
+  MSBFSWorkspace(unsigned int nNodes);
+  ~MSBFSWorkspace();
+
+  // Results of the last search, valid until the next one
+  inline const std::vector<int> &getReached() const { return reached; }
+  inline const std::vector<unsigned long long> &getMasks() const {
+    return masks;
+  }
+  inline const std::vector<size_t> &getLayers() const { return layers; }
 };
 
 class Graph {
@@ -47,32 +161,89 @@ private:
 
   int *nodes;
   int *edges;
+  // Weight of each edge, or NULL if every edge weighs 1
+  double *weights;
 
-#if REDUCER_IMPL == REDUCER_ORIG
-  void pbfs_walk_Bag(Bag<int> &, Bag_reducer<int> &, unsigned int,
-                     unsigned int[]) const;
-  void pbfs_walk_Pennant(Pennant<int> *, Bag_reducer<int> &, unsigned int,
-                         unsigned int[]) const;
-#else
-  void pbfs_walk_Bag(Bag<int> &, Bag_red<int> &, unsigned int,
-                     unsigned int[]) const;
-  void pbfs_walk_Pennant(Pennant<int> *, Bag_red<int> &, unsigned int,
-                         unsigned int[]) const;
-#endif
+  GraphOwnership ownership;
+  // The mapping of a GRAPH_MAPPED graph
+  void *mapBase;
+  size_t mapLength;
+
+  // Each node's parents, highest degree first, for bottom-up search.
+  // Built by indexParents.
+  int *parentNodes;
+  int *parents;
+
+  LayerHook layerHook;
+  void *layerHookArg;
+
+  void releaseArrays();
+  void copyArrays();
 
 public:
   // Constructor/Destructor
   Graph(int *ir, int *jc, int m, int n, int nnz);
+  Graph(int *nodes, int *edges, int n, int nnz, double *weights = NULL,
+        GraphOwnership ownership = GRAPH_OWNED);
+  Graph(void *base, size_t length, int *nodes, int *edges, int n, int nnz,
+        double *weights = NULL);
   ~Graph();
 
   // Accessors for basic graph data
   inline u_int numNodes() const { return nNodes; }
   inline u_int numEdges() const { return nEdges; }
+  inline const int *getNodes() const { return nodes; }
+  inline const int *getEdges() const { return edges; }
+  inline const double *getWeights() const { return weights; }
+  inline GraphOwnership getOwnership() const { return ownership; }
+
+  // Each node's neighbors are sorted, so edges can be found by binary
+  // search
+  inline bool hasEdge(int u, int v) const {
+    return std::binary_search(edges + nodes[u], edges + nodes[u + 1], v);
+  }
+
+  // Load-time cleanup of the edges
+  SimplifyStats simplify(bool symmetrize, bool noSelfLoops, bool noDuplicates);
+  // Build the parents index that pbfs_do requires
+  void indexParents();
+  // Call hook(arg, ...) at each layer of pbfs and pbfs_balanced, or
+  // stop if hook is NULL
+  inline void setLayerHook(LayerHook hook, void *arg) {
+    layerHook = hook;
+    layerHookArg = arg;
+  }
 
   // Various BFS versions
   int bfs(const int s, unsigned int distances[]) const;
+  // Check in parallel that distances are those of a BFS from s.
+  // Returns 0 if so, and otherwise -1, setting *bad, if bad is not NULL,
+  // to the least node at which the distances break an invariant.
+  int verify(const int s, const unsigned int distances[],
+             int *bad = NULL) const;
   int pbfs(const int s, unsigned int distances[]) const;
-  // int pbfs_wls(const int s, unsigned int distances[]) const;
+  int pbfs_wls(const int s, unsigned int distances[]) const;
+  int pbfs_compact(const int s, unsigned int distances[]) const;
+  int pbfs_do(const int s, unsigned int distances[]) const;
+  // PBFS that splits each layer into leaves of about equal edge counts
+  int pbfs_balanced(const int s, unsigned int distances[]) const;
+
+  // BFS that stops after maxDepth layers, or once maxVisited nodes have
+  // been visited
+  int pbfs_bounded(const int s, unsigned int maxDepth, unsigned int maxVisited,
+                   BFSWorkspace &ws) const;
+  // Distance from s to t by BFS from both ends, and the path if path is
+  // not NULL.  Requires indexParents.
+  int pbfs_bidir(const int s, const int t, unsigned int *distance,
+                 std::vector<int> *path, BidirWorkspace &ws) const;
+  // BFS from each of the sources s[0..count) at once, for up to
+  // maxDepth layers
+  int msbfs(const int s[], int count, unsigned int maxDepth,
+            MSBFSWorkspace &ws) const;
+
+  // Single-source shortest paths by edge weight
+  int dijkstra(const int s, double distances[]) const;
+  int sssp(const int s, double distances[], double delta) const;
 };
 
 // #include "graph.cpp"
@@ -0,0 +1,390 @@
+// Copyright (c) 2010-2024, Tao B. Schardl
+/*
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Graph statistics for tuning: degree distribution, connected
+// components, an estimate of the diameter, and the sizes of the BFS
+// layers from a source.  Prints JSON, including a suggested algorithm
+// and grain sizes.
+
+#include "pbfs.h"
+#include "util.h"
+#include <algorithm>
+#include <cilk/cilk.h>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+// Nodes handled by each strand in the reductions below
+const int STATS_BLOCK = 1 << 16;
+// Number of log2 degree buckets: degree 0, then [2^(k-1), 2^k)
+const int DEGREE_BUCKETS = 33;
+// Edges that a leaf of the traversal should scan, to amortize spawning
+const int LEAF_EDGES = 4096;
+// Strands over which the edges of the largest node should be spread
+const int HUB_CHUNKS = 64;
+
+// Structure defining command line argument values
+typedef struct {
+  string filename;
+  int source;
+} GraphStatsArgs;
+
+static GraphStatsArgs parse_stats_args(int argc, char *argv[]) {
+  GraphStatsArgs theArgs;
+  theArgs.filename = "";
+  theArgs.source = 0;
+
+  for (int arg_i = 1; arg_i < argc; ++arg_i) {
+    char *arg = argv[arg_i];
+
+    if (strcmp(arg, "-f") == 0 && arg_i + 1 < argc) {
+      theArgs.filename = argv[++arg_i];
+    } else if (strcmp(arg, "-s") == 0 && arg_i + 1 < argc) {
+      theArgs.source = atoi(argv[++arg_i]);
+    } else {
+      theArgs.filename = "";
+      break;
+    }
+  }
+  if (theArgs.filename.empty()) {
+    fprintf(stderr, "Usage: %s -f <filename> [-s <source>]\n", argv[0]);
+    fprintf(stderr, "Flags are:\n");
+    fprintf(stderr,
+            "\t-f <filename>\t: Specify the name of the graph file to use.\n");
+    fprintf(stderr, "\t-s <source>\t: Source of the BFS layers (default 0).\n");
+    exit(1);
+  }
+
+  return theArgs;
+}
+
+// Print s as a JSON string, escaping quotes, backslashes and control
+// characters
+static void print_json_string(const string &s) {
+  putchar('"');
+  for (size_t i = 0; i < s.size(); ++i) {
+    unsigned char c = s[i];
+    if (c == '"' || c == '\\')
+      printf("\\%c", c);
+    else if (c < 0x20)
+      printf("\\u%04x", c);
+    else
+      putchar(c);
+  }
+  putchar('"');
+}
+
+static int log2_bucket(int d) {
+  int k = 0;
+  while (d > 0) {
+    ++k;
+    d >>= 1;
+  }
+  return k;
+}
+
+// Largest power of two at most x, within [lo, hi]
+static int pow2_clamp(long x, int lo, int hi) {
+  int p = lo;
+  while (p < hi && 2L * p <= x)
+    p *= 2;
+  return p;
+}
+
+typedef struct {
+  int maxDegree;
+  int minDegree;
+  double avgDegree;
+  long histogram[DEGREE_BUCKETS];
+} DegreeStats;
+
+static DegreeStats degree_stats(const Graph *graph) {
+  int n = graph->numNodes();
+  const int *nodes = graph->getNodes();
+  int nblocks = (n + STATS_BLOCK - 1) / STATS_BLOCK;
+  vector<DegreeStats> block(nblocks);
+
+  cilk_for(int b = 0; b < nblocks; ++b) {
+    DegreeStats &s = block[b];
+    s.maxDegree = 0;
+    s.minDegree = INT_MAX;
+    memset(s.histogram, 0, sizeof(s.histogram));
+    int end = min(n, (b + 1) * STATS_BLOCK);
+    for (int u = b * STATS_BLOCK; u < end; ++u) {
+      int d = nodes[u + 1] - nodes[u];
+      s.maxDegree = max(s.maxDegree, d);
+      s.minDegree = min(s.minDegree, d);
+      ++s.histogram[log2_bucket(d)];
+    }
+  }
+
+  DegreeStats stats;
+  stats.maxDegree = 0;
+  stats.minDegree = INT_MAX;
+  stats.avgDegree = n > 0 ? (double)graph->numEdges() / n : 0;
+  memset(stats.histogram, 0, sizeof(stats.histogram));
+  for (int b = 0; b < nblocks; ++b) {
+    stats.maxDegree = max(stats.maxDegree, block[b].maxDegree);
+    stats.minDegree = min(stats.minDegree, block[b].minDegree);
+    for (int k = 0; k < DEGREE_BUCKETS; ++k)
+      stats.histogram[k] += block[b].histogram[k];
+  }
+  return stats;
+}
+
+// Degree at the given quantile, rounded down to its log2 bucket
+static int degree_quantile(const DegreeStats &deg, int n, double q) {
+  long want = (long)(q * n), seen = 0;
+  for (int k = 0; k < DEGREE_BUCKETS; ++k) {
+    seen += deg.histogram[k];
+    if (seen > want)
+      return k == 0 ? 0 : 1 << (k - 1);
+  }
+  return deg.maxDegree;
+}
+
+// Lock-free union-find: the root with the larger index is linked below
+// the other by compare-and-swap, and finds halve their paths.
+static int uf_find(int parent[], int x) {
+  while (true) {
+    int p = __atomic_load_n(&parent[x], __ATOMIC_RELAXED);
+    if (p == x)
+      return x;
+    int gp = __atomic_load_n(&parent[p], __ATOMIC_RELAXED);
+    if (p != gp)
+      __atomic_compare_exchange_n(&parent[x], &p, gp, false, __ATOMIC_RELAXED,
+                                  __ATOMIC_RELAXED);
+    x = gp;
+  }
+}
+
+static void uf_union(int parent[], int a, int b) {
+  while (true) {
+    a = uf_find(parent, a);
+    b = uf_find(parent, b);
+    if (a == b)
+      return;
+    if (a < b)
+      swap(a, b);
+    int expected = a;
+    if (__atomic_compare_exchange_n(&parent[a], &expected, b, false,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+      return;
+  }
+}
+
+// Count the weakly connected components, and the size of the largest
+static void components(const Graph *graph, int *count, int *largest) {
+  int n = graph->numNodes();
+  const int *nodes = graph->getNodes();
+  const int *edges = graph->getEdges();
+  int *parent = new int[n];
+  int *size = new int[n];
+
+  cilk_for(int u = 0; u < n; ++u) {
+    parent[u] = u;
+    size[u] = 0;
+  }
+  cilk_for(int u = 0; u < n; ++u) {
+    for (int i = nodes[u]; i < nodes[u + 1]; ++i)
+      uf_union(parent, u, edges[i]);
+  }
+  cilk_for(int u = 0; u < n; ++u)
+    __atomic_fetch_add(&size[uf_find(parent, u)], 1, __ATOMIC_RELAXED);
+
+  int nblocks = (n + STATS_BLOCK - 1) / STATS_BLOCK;
+  vector<int> blockCount(nblocks), blockLargest(nblocks);
+  cilk_for(int b = 0; b < nblocks; ++b) {
+    int end = min(n, (b + 1) * STATS_BLOCK);
+    int c = 0, l = 0;
+    for (int u = b * STATS_BLOCK; u < end; ++u) {
+      if (parent[u] == u) {
+        ++c;
+        l = max(l, size[u]);
+      }
+    }
+    blockCount[b] = c;
+    blockLargest[b] = l;
+  }
+
+  *count = 0;
+  *largest = 0;
+  for (int b = 0; b < nblocks; ++b) {
+    *count += blockCount[b];
+    *largest = max(*largest, blockLargest[b]);
+  }
+
+  delete[] parent;
+  delete[] size;
+}
+
+// Returns the reached node farthest from the source of distances, and
+// fills layers with the number of nodes at each distance
+static int farthest(int n, const unsigned int distances[],
+                    vector<long> &layers) {
+  int nblocks = (n + STATS_BLOCK - 1) / STATS_BLOCK;
+  vector<int> far(nblocks);
+  vector<vector<long>> blockLayers(nblocks);
+
+  cilk_for(int b = 0; b < nblocks; ++b) {
+    int end = min(n, (b + 1) * STATS_BLOCK);
+    int f = -1;
+    for (int u = b * STATS_BLOCK; u < end; ++u) {
+      unsigned int d = distances[u];
+      if (d == UINT_MAX)
+        continue;
+      if (f < 0 || d > distances[f])
+        f = u;
+      if (d >= blockLayers[b].size())
+        blockLayers[b].resize(d + 1);
+      ++blockLayers[b][d];
+    }
+    far[b] = f;
+  }
+
+  int f = -1;
+  layers.clear();
+  for (int b = 0; b < nblocks; ++b) {
+    if (far[b] >= 0 && (f < 0 || distances[far[b]] > distances[f]))
+      f = far[b];
+    if (blockLayers[b].size() > layers.size())
+      layers.resize(blockLayers[b].size());
+    for (size_t d = 0; d < blockLayers[b].size(); ++d)
+      layers[d] += blockLayers[b][d];
+  }
+  return f;
+}
+
+int main(int argc, char **argv) {
+  GraphStatsArgs args = parse_stats_args(argc, argv);
+  Graph *graph;
+
+  if (parseGraphFile(args.filename, &graph) != 0)
+    return -1;
+
+  int n = graph->numNodes();
+  long m = graph->numEdges();
+  if (args.source < 0 || args.source >= n) {
+    fprintf(stderr, "Source %d is not a node of the graph\n", args.source);
+    return -1;
+  }
+
+  DegreeStats deg = degree_stats(graph);
+  int ncomponents, largest;
+  components(graph, &ncomponents, &largest);
+
+  // BFS layers from the source, then the double-sweep lower bound on
+  // the diameter: the eccentricity of the node farthest from the source.
+  // In a directed graph, that may be less than the source's own.
+  unsigned int *distances = new unsigned int[n];
+  vector<long> layers, sweepLayers;
+  graph->pbfs_compact(args.source, distances);
+  int far = farthest(n, distances, layers);
+  unsigned int diameter = distances[far];
+  graph->pbfs_compact(far, distances);
+  int far2 = farthest(n, distances, sweepLayers);
+  diameter = max(diameter, distances[far2]);
+  delete[] distances;
+
+  long reached = 0, maxLayer = 0;
+  int maxLayerAt = 0;
+  for (size_t d = 0; d < layers.size(); ++d) {
+    reached += layers[d];
+    if (layers[d] > maxLayer) {
+      maxLayer = layers[d];
+      maxLayerAt = d;
+    }
+  }
+  double avgLayer = (double)reached / layers.size();
+
+  // Low-diameter graphs with a dominant layer profit from bottom-up
+  // search; long thin traversals from cheap, reducer-free layers
+  const char *alg;
+  if (maxLayer * 20 > reached && deg.avgDegree >= 4)
+    alg = "d";
+  else if (layers.size() > 100 && avgLayer < 4 * LEAF_EDGES)
+    alg = "c";
+  else
+    alg = "p";
+  int threshold =
+      pow2_clamp((long)(LEAF_EDGES / max(deg.avgDegree, 1.0)), 16, 2048);
+  bool parallelEdges = deg.maxDegree > 8 * LEAF_EDGES;
+  // Split the largest hub into enough chunks to spread it over
+  // HUB_CHUNKS strands, but none smaller than an ordinary high-degree
+  // node's list
+  int p99Degree = degree_quantile(deg, n, 0.99);
+  int edgeThreshold = pow2_clamp(
+      max((long)p99Degree, (long)deg.maxDegree / HUB_CHUNKS), 16, 2048);
+
+  printf("{\n");
+  printf("  \"file\": ");
+  print_json_string(args.filename);
+  printf(",\n");
+  printf("  \"nodes\": %d,\n", n);
+  printf("  \"edges\": %ld,\n", m);
+  printf("  \"degree\": {\n");
+  printf("    \"min\": %d,\n", deg.minDegree);
+  printf("    \"max\": %d,\n", deg.maxDegree);
+  printf("    \"avg\": %f,\n", deg.avgDegree);
+  printf("    \"p99\": %d,\n", p99Degree);
+  printf("    \"histogram\": [");
+  int lastBucket = log2_bucket(deg.maxDegree);
+  for (int k = 0; k <= lastBucket; ++k) {
+    long lo = k == 0 ? 0 : 1L << (k - 1), hi = k == 0 ? 0 : (1L << k) - 1;
+    printf("%s\n      {\"lo\": %ld, \"hi\": %ld, \"count\": %ld}",
+           k == 0 ? "" : ",", lo, hi, deg.histogram[k]);
+  }
+  printf("\n    ]\n");
+  printf("  },\n");
+  printf("  \"components\": {\"count\": %d, \"largest\": %d},\n", ncomponents,
+         largest);
+  printf("  \"diameter_estimate\": %u,\n", diameter);
+  printf("  \"layers\": {\n");
+  printf("    \"source\": %d,\n", args.source);
+  printf("    \"count\": %zu,\n", layers.size());
+  printf("    \"reached\": %ld,\n", reached);
+  printf("    \"max\": %ld,\n", maxLayer);
+  printf("    \"max_at\": %d,\n", maxLayerAt);
+  printf("    \"skew\": %f,\n", maxLayer / avgLayer);
+  printf("    \"sizes\": [");
+  for (size_t d = 0; d < layers.size(); ++d)
+    printf("%s%ld", d == 0 ? "" : ", ", layers[d]);
+  printf("]\n");
+  printf("  },\n");
+  printf("  \"recommend\": {\n");
+  printf("    \"algorithm\": \"%s\",\n", alg);
+  printf("    \"THRESHOLD\": %d,\n", threshold);
+  printf("    \"EDGE_THRESHOLD\": %d,\n", edgeThreshold);
+  printf("    \"PARALLEL_EDGES\": %s,\n", parallelEdges ? "true" : "false");
+  printf("    \"EXTRA_CFLAGS\": \"-DTHRESHOLD=%d -DEDGE_THRESHOLD=%d "
+         "-DPARALLEL_EDGES=%s\"\n",
+         threshold, edgeThreshold, parallelEdges ? "true" : "false");
+  printf("  }\n");
+  printf("}\n");
+
+  delete graph;
+  return 0;
+}
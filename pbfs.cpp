@@ -0,0 +1,342 @@
+// Copyright (c) 2010-2024, Tao B. Schardl
+/*
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Graph loading for libpbfs
+#include "pbfs.h"
+#include "reader.h"
+#include <cilk/cilk.h>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+const bool LOAD_DEBUG = false;
+
+static int CumulativeSum(int *arr, int size) {
+  int prev;
+  int tempnz = 0;
+  for (int i = 0; i < size; ++i) {
+    prev = arr[i];
+    arr[i] = tempnz;
+    tempnz += prev;
+  }
+  return tempnz;
+}
+
+// Number of row or column indices processed at a time, while the
+// reader fetches the ones that follow
+const int IDX_CHUNK = 1 << 20;
+
+int parseBinaryFile(const string filename, Graph **graph, bool weighted) {
+  int m, n, nnz;
+
+  // Read binary CSB matrix input
+  // Code and matrices adapted from oskitest.cpp by Aydin Buluc
+  if (LOAD_DEBUG)
+    printf("Reading input file %s\n", filename.c_str());
+
+  GraphReader *f = openGraphReader(filename);
+  if (!f) {
+    fprintf(stderr, "Problem reading binary input file %s\n", filename.c_str());
+    return -1;
+  }
+
+  int header[3];
+  if (f->read(header, sizeof(header)) != sizeof(header)) {
+    fprintf(stderr, "Problem reading header of binary input file %s\n",
+            filename.c_str());
+    delete f;
+    return -1;
+  }
+  m = header[0];
+  n = header[1];
+  nnz = header[2];
+
+  if (m <= 0 || n <= 0 || nnz <= 0) {
+    fprintf(stderr, "Problem with matrix size in binary input file %s\n",
+            filename.c_str());
+    delete f;
+    return -1;
+  }
+
+  if (m != n) {
+    fprintf(stderr, "Input file %s does not describe a graph\n",
+            filename.c_str());
+    delete f;
+    return -1;
+  }
+
+  if (LOAD_DEBUG)
+    printf("Reading %d-by-%d matrix having %d nonzeros\n", m, n, nnz);
+
+  // Read the row indices, counting the degree of each row in each chunk
+  // as soon as it arrives.  The column indices are then streamed
+  // straight into the graph's edge array, so only one nnz-length array
+  // is held besides the graph itself.  For a weighted graph, each row
+  // index is replaced by the position of its entry in the edge array,
+  // where its value is then streamed.
+  int *rowindices = new int[nnz];
+  int *nodes = new int[m + 1];
+  cilk_for(int k = 0; k < m; ++k) nodes[k] = 0;
+
+  bool badIndex = false;
+  for (int k = 0; k < nnz && !badIndex; k += IDX_CHUNK) {
+    int len = nnz - k < IDX_CHUNK ? nnz - k : IDX_CHUNK;
+    if (f->read(rowindices + k, (size_t)len * sizeof(int)) !=
+        (size_t)len * sizeof(int)) {
+      fprintf(stderr, "Problem with FREAD. Aborting.\n");
+      badIndex = true;
+      break;
+    }
+    cilk_for(int i = k; i < k + len; ++i) {
+      int row = rowindices[i];
+      if (row < 0 || row >= m)
+        __atomic_store_n(&badIndex, true, __ATOMIC_RELAXED);
+      else
+        __atomic_fetch_add(&nodes[row], 1, __ATOMIC_RELAXED);
+    }
+  }
+
+  nodes[m] = CumulativeSum(nodes, m);
+  int *w = new int[m];
+  cilk_for(int k = 0; k < m; ++k) w[k] = nodes[k];
+
+  if (LOAD_DEBUG)
+    printf("Making graph\n");
+
+  int *edges = new int[nnz];
+  int *colindices = new int[IDX_CHUNK];
+  for (int k = 0; k < nnz && !badIndex; k += IDX_CHUNK) {
+    int len = nnz - k < IDX_CHUNK ? nnz - k : IDX_CHUNK;
+    if (f->read(colindices, (size_t)len * sizeof(int)) !=
+        (size_t)len * sizeof(int)) {
+      fprintf(stderr, "Problem with FREAD. Aborting.\n");
+      badIndex = true;
+      break;
+    }
+    for (int i = 0; i < len; ++i) {
+      int col = colindices[i];
+      if (col < 0 || col >= n) {
+        badIndex = true;
+        break;
+      }
+      int pos = w[rowindices[k + i]]++;
+      edges[pos] = col;
+      if (weighted)
+        rowindices[k + i] = pos;
+    }
+  }
+  delete[] colindices;
+
+  double *weights = NULL;
+  if (weighted && !badIndex) {
+    weights = new double[nnz];
+    double *values = new double[IDX_CHUNK];
+    for (int k = 0; k < nnz && !badIndex; k += IDX_CHUNK) {
+      int len = nnz - k < IDX_CHUNK ? nnz - k : IDX_CHUNK;
+      if (f->read(values, (size_t)len * sizeof(double)) !=
+          (size_t)len * sizeof(double)) {
+        fprintf(stderr, "Problem with FREAD. Aborting.\n");
+        badIndex = true;
+        break;
+      }
+      cilk_for(int i = 0; i < len; ++i) weights[rowindices[k + i]] = values[i];
+    }
+    delete[] values;
+  }
+
+  delete[] w;
+  delete[] rowindices;
+  delete f;
+
+  if (badIndex) {
+    fprintf(stderr, "Problem with indices in binary input file %s\n",
+            filename.c_str());
+    delete[] nodes;
+    delete[] edges;
+    delete[] weights;
+    return -1;
+  }
+
+  *graph = new Graph(nodes, edges, m, nnz, weights);
+
+  return 0;
+}
+
+// Build a graph with n vertices from the edges in el, which are freed.
+static Graph *buildGraph(EdgeList *el) {
+  int n = el->n, nnz = el->nnz;
+  int *nodes = new int[n + 1];
+  cilk_for(int k = 0; k < n; ++k) nodes[k] = 0;
+  cilk_for(int k = 0; k < nnz; ++k)
+      __atomic_fetch_add(&nodes[el->rows[k]], 1, __ATOMIC_RELAXED);
+
+  nodes[n] = CumulativeSum(nodes, n);
+  int *w = new int[n];
+  cilk_for(int k = 0; k < n; ++k) w[k] = nodes[k];
+
+  int *edges = new int[nnz];
+  double *weights = el->vals ? new double[nnz] : NULL;
+  for (int k = 0; k < nnz; ++k) {
+    int pos = w[el->rows[k]]++;
+    edges[pos] = el->cols[k];
+    if (weights)
+      weights[pos] = el->vals[k];
+  }
+
+  delete[] w;
+  delete[] el->rows;
+  delete[] el->cols;
+  delete[] el->vals;
+  return new Graph(nodes, edges, n, nnz, weights);
+}
+
+int parseGraphFile(const string filename, Graph **graph, bool weighted) {
+  string name = filename;
+  if (name.size() > 4 && name.compare(name.size() - 4, 4, ".bz2") == 0)
+    name.resize(name.size() - 4);
+  string ext = name.substr(name.find_last_of('.') == string::npos
+                               ? name.size()
+                               : name.find_last_of('.'));
+
+  EdgeList el;
+  if (ext == ".csr") {
+    if (name != filename) {
+      fprintf(stderr, "CSR graph file %s cannot be mapped compressed\n",
+              filename.c_str());
+      return -1;
+    }
+    return mapGraphFile(filename, graph, weighted);
+  } else if (ext == ".mtx") {
+    if (readMatrixMarket(filename, &el, weighted) != 0)
+      return -1;
+  } else if (ext == ".txt" || ext == ".el" || ext == ".edges") {
+    if (readEdgeList(filename, &el) != 0)
+      return -1;
+  } else {
+    return parseBinaryFile(filename, graph, weighted);
+  }
+
+  if (LOAD_DEBUG)
+    printf("Read %d vertices and %d edges from %s\n", el.n, el.nnz,
+           filename.c_str());
+
+  *graph = buildGraph(&el);
+  return 0;
+}
+
+// Offsets of the arrays in a CSR graph file, and the file's size
+static void csrLayout(long long n, long long nnz, bool weighted,
+                      size_t *edgesAt, size_t *weightsAt, size_t *size) {
+  size_t a = CSR_FILE_ALIGN;
+  *edgesAt = (sizeof(CSRFileHeader) + (n + 1) * sizeof(int) + a - 1) / a * a;
+  *weightsAt = (*edgesAt + nnz * sizeof(int) + a - 1) / a * a;
+  *size = weighted ? *weightsAt + nnz * sizeof(double)
+                   : *edgesAt + nnz * sizeof(int);
+}
+
+int mapGraphFile(const string filename, Graph **graph, bool weighted) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    fprintf(stderr, "Problem opening CSR graph file %s\n", filename.c_str());
+    if (fd >= 0)
+      close(fd);
+    return -1;
+  }
+  size_t length = st.st_size;
+  void *base = length >= sizeof(CSRFileHeader)
+                   ? mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0)
+                   : MAP_FAILED;
+  close(fd);
+  if (base == MAP_FAILED) {
+    fprintf(stderr, "Problem mapping CSR graph file %s\n", filename.c_str());
+    return -1;
+  }
+
+  // Check only the header and the size, so that no more of the file is
+  // read until the graph is searched
+  const CSRFileHeader *h = (const CSRFileHeader *)base;
+  size_t edgesAt, weightsAt, size;
+  bool ok = memcmp(h->magic, CSR_FILE_MAGIC, sizeof(CSR_FILE_MAGIC)) == 0 &&
+            h->n > 0 && h->n < INT_MAX && h->nnz >= 0 && h->nnz <= INT_MAX;
+  if (ok) {
+    csrLayout(h->n, h->nnz, h->weighted, &edgesAt, &weightsAt, &size);
+    ok = size == length &&
+         ((const int *)((const char *)base + sizeof(CSRFileHeader)))[h->n] ==
+             h->nnz;
+  }
+  if (!ok) {
+    fprintf(stderr, "%s is not a valid CSR graph file\n", filename.c_str());
+    munmap(base, length);
+    return -1;
+  }
+
+  char *bytes = (char *)base;
+  *graph = new Graph(base, length, (int *)(bytes + sizeof(CSRFileHeader)),
+                     (int *)(bytes + edgesAt), h->n, h->nnz,
+                     weighted && h->weighted ? (double *)(bytes + weightsAt)
+                                             : NULL);
+  return 0;
+}
+
+int writeGraphFile(const string filename, const Graph *graph) {
+  CSRFileHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, CSR_FILE_MAGIC, sizeof(CSR_FILE_MAGIC));
+  h.n = graph->numNodes();
+  h.nnz = graph->numEdges();
+  h.weighted = graph->getWeights() != NULL;
+  size_t edgesAt, weightsAt, size;
+  csrLayout(h.n, h.nnz, h.weighted, &edgesAt, &weightsAt, &size);
+
+  FILE *f = fopen(filename.c_str(), "wb");
+  if (!f) {
+    fprintf(stderr, "Problem creating CSR graph file %s\n", filename.c_str());
+    return -1;
+  }
+  // Zeros to pad each array to its offset
+  static const char pad[CSR_FILE_ALIGN] = {0};
+  size_t nodesEnd = sizeof(h) + (h.n + 1) * sizeof(int);
+  size_t edgesEnd = edgesAt + h.nnz * sizeof(int);
+  bool ok =
+      fwrite(&h, sizeof(h), 1, f) == 1 &&
+      fwrite(graph->getNodes(), sizeof(int), h.n + 1, f) == h.n + 1 &&
+      fwrite(pad, 1, edgesAt - nodesEnd, f) == edgesAt - nodesEnd &&
+      fwrite(graph->getEdges(), sizeof(int), h.nnz, f) == h.nnz;
+  if (ok && h.weighted)
+    ok = fwrite(pad, 1, weightsAt - edgesEnd, f) == weightsAt - edgesEnd &&
+         fwrite(graph->getWeights(), sizeof(double), h.nnz, f) == h.nnz;
+  if (fclose(f) != 0 || !ok) {
+    fprintf(stderr, "Problem writing CSR graph file %s\n", filename.c_str());
+    return -1;
+  }
+
+  return 0;
+}
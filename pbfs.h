@@ -0,0 +1,99 @@
+// Copyright (c) 2010-2024, Tao B. Schardl
+/*
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Public interface of libpbfs: graphs, loaded from a file or built
+// from CSR arrays, and the traversals over them.  Searches that take a
+// workspace reuse it from one call to the next, so that repeated
+// queries on one graph avoid reallocating and reinitializing their
+// state.
+
+#ifndef PBFS_H
+#define PBFS_H
+
+#include "dyngraph.h"
+#include "graph.h"
+#include <string>
+
+#define PBFS_VERSION_MAJOR 1
+#define PBFS_VERSION_MINOR 0
+
+// Parse a binary graph file.  The values are read as edge weights if
+// weighted is set, and skipped otherwise.  Returns 0 on success.
+int parseBinaryFile(const std::string filename, Graph **graph,
+                    bool weighted = false);
+
+// Parse a graph from a Matrix Market (.mtx) file, a SNAP edge list
+// (.txt, .el or .edges), or otherwise a binary file, any of which may
+// be compressed with bzip2 (.bz2), or map an uncompressed CSR graph
+// file (.csr).  If weighted is set, the values of binary and Matrix
+// Market files become edge weights.  Returns 0 on success.
+int parseGraphFile(const std::string filename, Graph **graph,
+                   bool weighted = false);
+
+// Header of a CSR graph file (.csr), which is followed by nodes[0..n],
+// edges[0..nnz) and, if weighted is set, weights[0..nnz), each starting
+// at a multiple of CSR_FILE_ALIGN bytes
+typedef struct {
+  char magic[8];
+  long long n;
+  long long nnz;
+  long long weighted;
+} CSRFileHeader;
+
+#define CSR_FILE_MAGIC "PBFSCSR"
+#define CSR_FILE_ALIGN 8
+
+// Map a CSR graph file into memory, without reading or copying it.  The
+// graph unmaps the file when it is destroyed.  The weights are mapped
+// if weighted is set and the file has them.  Returns 0 on success.
+int mapGraphFile(const std::string filename, Graph **graph,
+                 bool weighted = false);
+
+// Write graph as a CSR graph file.  Returns 0 on success.
+int writeGraphFile(const std::string filename, const Graph *graph);
+
+// Generate a Graph500 Kronecker graph with 2^scale nodes and
+// edgeFactor * 2^scale undirected edges.  The graph is the same for a
+// given seed however many workers generate it.  Returns 0 on success.
+int generateKronecker(int scale, int edgeFactor, unsigned long long seed,
+                      Graph **graph);
+
+// Generate a grid of side^dims nodes, for dims up to 3, each joined to
+// its neighbors along each dimension.  Returns 0 on success.
+int generateGrid(int side, int dims, Graph **graph);
+
+// Generate a uniform random multigraph of n nodes and n * degree / 2
+// undirected edges, each between two independently drawn uniform nodes,
+// like the Erdos-Renyi G(n, m) but with self loops and duplicate edges
+// kept, as in generateKronecker; Graph::simplify removes them.  Returns
+// 0 on success.
+int generateUniform(int n, int degree, unsigned long long seed,
+                    Graph **graph);
+
+// Generate a graph from a spec: kron:<scale>[:<edgefactor>[:<seed>]],
+// grid:<side>[:<dims>] or er:<nodes>[:<degree>[:<seed>]].  The edge
+// factor and degree default to 16, dims to 3 and the seed to 1.
+// Returns 0 on success.
+int generateGraph(const std::string spec, Graph **graph);
+
+#endif // PBFS_H
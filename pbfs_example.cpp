@@ -0,0 +1,90 @@
+// Copyright (c) 2010-2024, Tao B. Schardl
+/*
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Example of embedding libpbfs: build a graph from CSR arrays, or load
+// one from the file named on the command line, and search it.
+
+#include "pbfs.h"
+#include <climits>
+#include <cstdio>
+#include <vector>
+
+int main(int argc, char **argv) {
+  Graph *graph;
+
+  if (argc > 1) {
+    if (parseGraphFile(argv[1], &graph) != 0)
+      return -1;
+  } else {
+    // A ring of 6 nodes with a chord between 0 and 3.  The graph adopts
+    // the arrays without copying them, and frees them with delete[].
+    // Arrays that the caller keeps, such as ones in shared memory, can
+    // be wrapped with GRAPH_BORROWED instead.
+    int n = 6, nnz = 14;
+    int *nodes = new int[n + 1]{0, 3, 5, 7, 10, 12, 14};
+    int *edges = new int[nnz]{1, 3, 5, 0, 2, 1, 3, 0, 2, 4, 3, 5, 0, 4};
+    graph = new Graph(nodes, edges, n, nnz);
+  }
+  int n = graph->numNodes();
+  printf("%d nodes, %u edges\n", n, graph->numEdges());
+
+  // A full search, into a caller-owned distance array
+  unsigned int *distances = new unsigned int[n];
+  graph->pbfs(0, distances);
+  int reached = 0;
+  unsigned int depth = 0;
+  for (int v = 0; v < n; ++v) {
+    if (distances[v] != UINT_MAX) {
+      ++reached;
+      depth = std::max(depth, distances[v]);
+    }
+  }
+  printf("PBFS from 0 reaches %d nodes in %u layers\n", reached, depth + 1);
+  delete[] distances;
+
+  // Repeated queries reuse a workspace, which each query resets only
+  // where the last one searched
+  BFSWorkspace ws(n);
+  for (int s = 0; s < n && s < 3; ++s) {
+    graph->pbfs_bounded(s, 2, UINT_MAX, ws);
+    printf("%zu nodes are within 2 hops of %d\n", ws.getVisited().size(), s);
+  }
+
+  // Point-to-point queries search from both ends
+  graph->indexParents();
+  BidirWorkspace bws(n);
+  unsigned int distance;
+  std::vector<int> path;
+  graph->pbfs_bidir(0, n - 1, &distance, &path, bws);
+  if (distance == UINT_MAX) {
+    printf("%d is unreachable from 0\n", n - 1);
+  } else {
+    printf("Distance from 0 to %d is %u:", n - 1, distance);
+    for (size_t i = 0; i < path.size(); ++i)
+      printf(" %d", path[i]);
+    printf("\n");
+  }
+
+  delete graph;
+  return 0;
+}
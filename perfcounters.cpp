@@ -0,0 +1,116 @@
+// Copyright (c) 2010-2024, Tao B. Schardl
+/*
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "perfcounters.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+const char *PERF_EVENT_NAMES[PERF_NUM_EVENTS] = {
+    "cycles", "instructions", "LLC-load-misses", "dTLB-load-misses",
+    "branch-misses"};
+
+static const unsigned int PERF_TYPES[PERF_NUM_EVENTS] = {
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+    PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE};
+
+static const unsigned long long PERF_CONFIGS[PERF_NUM_EVENTS] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+    PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+    PERF_COUNT_HW_BRANCH_MISSES};
+
+PerfCounters::PerfCounters() {}
+
+PerfCounters::~PerfCounters() {
+  for (int e = 0; e < PERF_NUM_EVENTS; ++e)
+    for (size_t i = 0; i < fds[e].size(); ++i)
+      close(fds[e][i]);
+}
+
+int PerfCounters::open() {
+  std::vector<pid_t> threads;
+  DIR *dir = opendir("/proc/self/task");
+  if (dir == NULL) {
+    fprintf(stderr, "Cannot list threads: %s\n", strerror(errno));
+    return -1;
+  }
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL)
+    if (entry->d_name[0] != '.')
+      threads.push_back(atoi(entry->d_name));
+  closedir(dir);
+
+  bool any = false;
+  for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPES[e];
+    attr.config = PERF_CONFIGS[e];
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+      int fd = syscall(SYS_perf_event_open, &attr, threads[i], -1, -1, 0);
+      if (fd < 0) {
+        fprintf(stderr, "Cannot count %s: %s\n", PERF_EVENT_NAMES[e],
+                strerror(errno));
+        for (size_t j = 0; j < fds[e].size(); ++j)
+          close(fds[e][j]);
+        fds[e].clear();
+        break;
+      }
+      fds[e].push_back(fd);
+    }
+    any = any || !fds[e].empty();
+  }
+  return any ? 0 : -1;
+}
+
+void PerfCounters::read(unsigned long long values[PERF_NUM_EVENTS]) const {
+  for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+    if (fds[e].empty()) {
+      values[e] = PERF_UNAVAILABLE;
+      continue;
+    }
+    double sum = 0;
+    for (size_t i = 0; i < fds[e].size(); ++i) {
+      // The count, the time enabled and the time running
+      unsigned long long buf[3];
+      if (::read(fds[e][i], buf, sizeof(buf)) != sizeof(buf) || buf[2] == 0)
+        continue;
+      sum += (double)buf[0] * buf[1] / buf[2];
+    }
+    values[e] = (unsigned long long)sum;
+  }
+}
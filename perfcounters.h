@@ -0,0 +1,66 @@
+// Copyright (c) 2010-2024, Tao B. Schardl
+/*
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <vector>
+
+// Hardware events counted by PerfCounters
+enum PerfEvent {
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_LLC_MISSES,
+  PERF_DTLB_MISSES,
+  PERF_BRANCH_MISSES,
+  PERF_NUM_EVENTS
+};
+
+extern const char *PERF_EVENT_NAMES[PERF_NUM_EVENTS];
+
+// Value read for an event that could not be counted
+const unsigned long long PERF_UNAVAILABLE = ~0ULL;
+
+// Hardware counters from perf_event_open, one set per thread of this
+// process, summed when read.  The threads are those running when the
+// counters are opened, which should be after the Cilk workers have
+// started.
+class PerfCounters {
+
+private:
+  // File descriptors of each event, one per thread
+  std::vector<int> fds[PERF_NUM_EVENTS];
+
+public:
+  PerfCounters();
+  ~PerfCounters();
+
+  // Open the counters on each thread, returning -1 if no event can be
+  // counted.  Events the hardware lacks are left out.
+  int open();
+  // Current totals of the events since they were opened, scaled up if
+  // the kernel multiplexed them
+  void read(unsigned long long values[PERF_NUM_EVENTS]) const;
+};
+
+#endif // PERFCOUNTERS_H
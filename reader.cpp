@@ -0,0 +1,1084 @@
+// Copyright (c) 2010-2024, Tao B. Schardl
+/*
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// Graph input streams: plain files, read ahead asynchronously, and
+// bzip2-compressed files whose blocks are decompressed in parallel.
+// Also parsers for text formats, which split the text among workers at
+// line boundaries.
+#include "reader.h"
+#include <algorithm>
+#include <bzlib.h>
+#include <cctype>
+#include <cerrno>
+#include <cilk/cilk.h>
+#include <cilk/cilk_api.h>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#ifndef USE_IO_URING
+#define USE_IO_URING 1
+#endif
+
+#if USE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif // USE_IO_URING
+
+using namespace std;
+
+const bool READER_DEBUG = false;
+
+// Bit patterns that start a bzip2 block and end a bzip2 stream
+const uint64_t BZ2_BLOCK_MAGIC = 0x314159265359ULL;
+const uint64_t BZ2_EOS_MAGIC = 0x177245385090ULL;
+// Bytes of compressed input scanned for magic numbers by each strand
+const size_t BZ2_SCAN_CHUNK = 1 << 20;
+// Blocks decompressed in parallel per batch, per worker
+const int BZ2_BLOCKS_PER_WORKER = 2;
+// Reads kept in flight ahead of the consumer of a plain file, and their
+// size in bytes
+const int PREFETCH_DEPTH = 8;
+const size_t PREFETCH_CHUNK = 4 << 20;
+
+class FileReader : public GraphReader {
+private:
+  FILE *f;
+
+public:
+  FileReader(FILE *f) : f(f) {}
+  ~FileReader() { fclose(f); }
+
+  size_t read(void *buf, size_t n) { return fread(buf, 1, n, f); }
+};
+
+// Asynchronous positioned reads into numbered slots.  Each slot holds at
+// most one outstanding read.
+class AsyncIO {
+public:
+  virtual ~AsyncIO() {}
+
+  virtual bool submit(int slot, char *buf, size_t len, off_t off) = 0;
+
+  // Wait for the read in slot to finish.  Returns the number of bytes
+  // read, or -1 on error.
+  virtual ssize_t wait(int slot) = 0;
+};
+
+#if USE_IO_URING
+// Reads through an io_uring, driven with raw system calls
+class UringIO : public AsyncIO {
+private:
+  int fd, ringFd;
+  size_t sqSize, cqSize, sqeSize;
+  void *sqRing, *cqRing;
+  io_uring_sqe *sqes;
+  unsigned *sqTail, *sqMask, *sqArray;
+  unsigned *cqHead, *cqTail, *cqMask;
+  io_uring_cqe *cqes;
+
+  vector<iovec> iov;
+  vector<ssize_t> result;
+  vector<bool> done;
+
+  UringIO(int fd, int ringFd, io_uring_params &p);
+
+public:
+  ~UringIO();
+
+  // Returns NULL if this kernel does not support io_uring
+  static UringIO *create(int fd, int depth);
+
+  bool submit(int slot, char *buf, size_t len, off_t off);
+  ssize_t wait(int slot);
+};
+
+UringIO *UringIO::create(int fd, int depth) {
+  io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  int ringFd = syscall(__NR_io_uring_setup, depth, &p);
+  if (ringFd < 0)
+    return NULL;
+
+  UringIO *io = new UringIO(fd, ringFd, p);
+  if (io->sqRing == MAP_FAILED || io->cqRing == MAP_FAILED ||
+      io->sqes == MAP_FAILED) {
+    delete io;
+    return NULL;
+  }
+  io->iov.resize(depth);
+  io->result.resize(depth);
+  io->done.resize(depth, true);
+  return io;
+}
+
+UringIO::UringIO(int fd, int ringFd, io_uring_params &p)
+    : fd(fd), ringFd(ringFd) {
+  sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  cqSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+  sqeSize = p.sq_entries * sizeof(io_uring_sqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+    sqSize = cqSize = max(sqSize, cqSize);
+
+  sqRing = mmap(NULL, sqSize, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+    cqRing = sqRing;
+  else
+    cqRing = mmap(NULL, cqSize, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+  sqes = (io_uring_sqe *)mmap(NULL, sqeSize, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, ringFd,
+                              IORING_OFF_SQES);
+
+  char *sq = (char *)sqRing, *cq = (char *)cqRing;
+  sqTail = (unsigned *)(sq + p.sq_off.tail);
+  sqMask = (unsigned *)(sq + p.sq_off.ring_mask);
+  sqArray = (unsigned *)(sq + p.sq_off.array);
+  cqHead = (unsigned *)(cq + p.cq_off.head);
+  cqTail = (unsigned *)(cq + p.cq_off.tail);
+  cqMask = (unsigned *)(cq + p.cq_off.ring_mask);
+  cqes = (io_uring_cqe *)(cq + p.cq_off.cqes);
+}
+
+UringIO::~UringIO() {
+  // Reads still in flight write into buffers about to be freed
+  for (size_t i = 0; i < done.size(); ++i)
+    if (!done[i])
+      wait(i);
+  if (sqes != MAP_FAILED)
+    munmap(sqes, sqeSize);
+  if (cqRing != sqRing && cqRing != MAP_FAILED)
+    munmap(cqRing, cqSize);
+  if (sqRing != MAP_FAILED)
+    munmap(sqRing, sqSize);
+  close(ringFd);
+}
+
+bool UringIO::submit(int slot, char *buf, size_t len, off_t off) {
+  iov[slot].iov_base = buf;
+  iov[slot].iov_len = len;
+
+  // Only this thread produces submissions
+  unsigned tail = *sqTail;
+  unsigned idx = tail & *sqMask;
+  io_uring_sqe *sqe = &sqes[idx];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_READV;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t)&iov[slot];
+  sqe->len = 1;
+  sqe->off = off;
+  sqe->user_data = slot;
+  sqArray[idx] = idx;
+  __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+  if (syscall(__NR_io_uring_enter, ringFd, 1, 0, 0, NULL, 0) != 1)
+    return false;
+  done[slot] = false;
+  return true;
+}
+
+ssize_t UringIO::wait(int slot) {
+  while (!done[slot]) {
+    unsigned head = *cqHead;
+    if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+      if (syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS,
+                  NULL, 0) < 0 &&
+          errno != EINTR)
+        return -1;
+      continue;
+    }
+    io_uring_cqe *cqe = &cqes[head & *cqMask];
+    result[cqe->user_data] = cqe->res < 0 ? -1 : cqe->res;
+    done[cqe->user_data] = true;
+    __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+  }
+  return result[slot];
+}
+#endif // USE_IO_URING
+
+// Reads with pread on a helper thread, for kernels without io_uring
+class ThreadIO : public AsyncIO {
+private:
+  struct Request {
+    int slot;
+    char *buf;
+    size_t len;
+    off_t off;
+  };
+
+  int fd;
+  mutex lock;
+  condition_variable cv;
+  deque<Request> queue;
+  vector<ssize_t> result;
+  vector<bool> done;
+  bool stop;
+  thread worker;
+
+  void run();
+
+public:
+  ThreadIO(int fd, int depth)
+      : fd(fd), result(depth), done(depth, true), stop(false),
+        worker(&ThreadIO::run, this) {}
+  ~ThreadIO();
+
+  bool submit(int slot, char *buf, size_t len, off_t off);
+  ssize_t wait(int slot);
+};
+
+ThreadIO::~ThreadIO() {
+  {
+    unique_lock<mutex> l(lock);
+    stop = true;
+  }
+  cv.notify_all();
+  worker.join();
+}
+
+void ThreadIO::run() {
+  unique_lock<mutex> l(lock);
+  while (true) {
+    cv.wait(l, [this] { return stop || !queue.empty(); });
+    // Drain the queue before stopping, so no buffer is written after
+    // it is freed
+    if (queue.empty())
+      return;
+    Request r = queue.front();
+    queue.pop_front();
+
+    l.unlock();
+    ssize_t got = pread(fd, r.buf, r.len, r.off);
+    l.lock();
+
+    result[r.slot] = got;
+    done[r.slot] = true;
+    cv.notify_all();
+  }
+}
+
+bool ThreadIO::submit(int slot, char *buf, size_t len, off_t off) {
+  {
+    unique_lock<mutex> l(lock);
+    done[slot] = false;
+    queue.push_back({slot, buf, len, off});
+  }
+  cv.notify_all();
+  return true;
+}
+
+ssize_t ThreadIO::wait(int slot) {
+  unique_lock<mutex> l(lock);
+  cv.wait(l, [this, slot] { return (bool)done[slot]; });
+  return result[slot];
+}
+
+// Plain file read sequentially, with PREFETCH_DEPTH chunks read ahead
+// asynchronously, so that the caller's processing of one chunk overlaps
+// the reading of the next ones.
+class PrefetchReader : public GraphReader {
+private:
+  int fd;
+  off_t size;
+  AsyncIO *io;
+
+  char *buf[PREFETCH_DEPTH];
+  size_t len[PREFETCH_DEPTH];
+  off_t start[PREFETCH_DEPTH];
+  off_t nextOff;
+  int cur;
+  size_t pos;
+  bool ready, failed;
+
+  void submit(int slot);
+
+public:
+  PrefetchReader(int fd, off_t size);
+  ~PrefetchReader();
+
+  size_t read(void *buf, size_t n);
+};
+
+PrefetchReader::PrefetchReader(int fd, off_t size)
+    : fd(fd), size(size), io(NULL), nextOff(0), cur(0), pos(0), ready(false),
+      failed(false) {
+#if USE_IO_URING
+  io = UringIO::create(fd, PREFETCH_DEPTH);
+#endif // USE_IO_URING
+  if (!io)
+    io = new ThreadIO(fd, PREFETCH_DEPTH);
+  if (READER_DEBUG)
+    printf("Prefetching with %s\n",
+           dynamic_cast<ThreadIO *>(io) ? "a pread thread" : "io_uring");
+
+  for (int i = 0; i < PREFETCH_DEPTH; ++i) {
+    buf[i] = new char[PREFETCH_CHUNK];
+    submit(i);
+  }
+}
+
+PrefetchReader::~PrefetchReader() {
+  delete io;
+  for (int i = 0; i < PREFETCH_DEPTH; ++i)
+    delete[] buf[i];
+  close(fd);
+}
+
+// Start reading the next chunk of the file into slot
+void PrefetchReader::submit(int slot) {
+  start[slot] = nextOff;
+  len[slot] = min((off_t)PREFETCH_CHUNK, size - nextOff);
+  if (len[slot] > 0 && !io->submit(slot, buf[slot], len[slot], nextOff))
+    failed = true;
+  nextOff += len[slot];
+}
+
+size_t PrefetchReader::read(void *out, size_t n) {
+  size_t done = 0;
+
+  while (done < n && !failed) {
+    if (!ready) {
+      if (len[cur] == 0)
+        break;
+      ssize_t got = io->wait(cur);
+      // Finish short reads synchronously
+      while (got >= 0 && (size_t)got < len[cur]) {
+        ssize_t more =
+            pread(fd, buf[cur] + got, len[cur] - got, start[cur] + got);
+        got = more > 0 ? got + more : -1;
+      }
+      if (got < 0) {
+        fprintf(stderr, "Problem reading input file\n");
+        failed = true;
+        break;
+      }
+      ready = true;
+    }
+
+    size_t l = min(n - done, len[cur] - pos);
+    memcpy((char *)out + done, buf[cur] + pos, l);
+    done += l;
+    pos += l;
+    if (pos == len[cur]) {
+      submit(cur);
+      cur = (cur + 1) % PREFETCH_DEPTH;
+      pos = 0;
+      ready = false;
+    }
+  }
+  return done;
+}
+
+// Appends bits, most-significant first, to a byte buffer
+class BitWriter {
+private:
+  vector<char> &out;
+  uint64_t acc;
+  int nacc;
+
+public:
+  BitWriter(vector<char> &out) : out(out), acc(0), nacc(0) {}
+
+  void put(uint64_t bits, int n) {
+    for (int i = n - 1; i >= 0; --i) {
+      acc = (acc << 1) | ((bits >> i) & 1);
+      if (++nacc == 8) {
+        out.push_back((char)acc);
+        acc = 0;
+        nacc = 0;
+      }
+    }
+  }
+
+  // Append nbits bits of src, starting at bit offset bit
+  void copy(const unsigned char *src, uint64_t bit, uint64_t nbits) {
+    const unsigned char *p = src + (bit >> 3);
+    int r = bit & 7;
+    if (nacc == 0) {
+      // Fast path: shift whole bytes into place
+      uint64_t nbytes = nbits >> 3;
+      for (uint64_t j = 0; j < nbytes; ++j)
+        out.push_back(r == 0 ? p[j]
+                             : (char)((p[j] << r) | (p[j + 1] >> (8 - r))));
+      bit += nbytes << 3;
+      nbits &= 7;
+    }
+    for (uint64_t i = 0; i < nbits; ++i, ++bit)
+      put((src[bit >> 3] >> (7 - (bit & 7))) & 1, 1);
+  }
+
+  void flush() {
+    if (nacc > 0)
+      put(0, 8 - nacc);
+  }
+};
+
+class Bz2Reader : public GraphReader {
+private:
+  const unsigned char *data;
+  size_t size;
+
+  // Bit offsets of the block magic numbers, and of the bit past the end
+  // of each block
+  vector<uint64_t> blockStart, blockEnd;
+  size_t nextBlock;
+
+  // Decompressed contents of the current batch of blocks
+  vector<vector<char>> batch;
+  size_t batchBlock, batchOffset;
+
+  // Serial decompression, used if the blocks cannot be split apart
+  bool serial;
+  bz_stream strm;
+  size_t strmIn;
+  size_t delivered;
+
+  uint64_t getBits(uint64_t bit, int n) const;
+  void findBlocks();
+  bool decompressBlock(size_t b, vector<char> &out) const;
+  bool nextBatch();
+  void startSerial();
+  size_t readSerial(char *buf, size_t n);
+
+public:
+  Bz2Reader(const unsigned char *data, size_t size);
+  ~Bz2Reader();
+
+  size_t read(void *buf, size_t n);
+};
+
+Bz2Reader::Bz2Reader(const unsigned char *data, size_t size)
+    : data(data), size(size), nextBlock(0), batchBlock(0), batchOffset(0),
+      serial(false), strmIn(0), delivered(0) {
+  findBlocks();
+  if (blockStart.empty())
+    startSerial();
+}
+
+Bz2Reader::~Bz2Reader() {
+  if (serial)
+    BZ2_bzDecompressEnd(&strm);
+  munmap((void *)data, size);
+}
+
+// Returns the n <= 57 bits starting at bit offset bit
+uint64_t Bz2Reader::getBits(uint64_t bit, int n) const {
+  uint64_t w = 0;
+  for (int j = 0; j < 8; ++j) {
+    size_t p = (bit >> 3) + j;
+    w = (w << 8) | (p < size ? data[p] : 0);
+  }
+  return (w >> (64 - (bit & 7) - n)) & ((1ULL << n) - 1);
+}
+
+// Locate the bit-aligned block boundaries.  Each chunk of the input is
+// scanned in parallel for block and end-of-stream magic numbers.
+void Bz2Reader::findBlocks() {
+  size_t nchunks = (size + BZ2_SCAN_CHUNK - 1) / BZ2_SCAN_CHUNK;
+  vector<vector<uint64_t>> found(nchunks);
+
+  cilk_for(size_t c = 0; c < nchunks; ++c) {
+    size_t end = min(size, (c + 1) * BZ2_SCAN_CHUNK);
+    for (size_t p = c * BZ2_SCAN_CHUNK; p < end; ++p) {
+      uint64_t w = 0;
+      for (int j = 0; j < 8; ++j)
+        w = (w << 8) | (p + j < size ? data[p + j] : 0);
+      for (int r = 0; r < 8; ++r) {
+        uint64_t magic = (w >> (16 - r)) & 0xffffffffffffULL;
+        // Tag end-of-stream magic numbers with the low bit
+        if (magic == BZ2_BLOCK_MAGIC)
+          found[c].push_back((uint64_t)(p * 8 + r) << 1);
+        else if (magic == BZ2_EOS_MAGIC)
+          found[c].push_back((uint64_t)(p * 8 + r) << 1 | 1);
+      }
+    }
+  }
+
+  // A block extends from its magic number to the next magic number
+  for (size_t c = 0; c < nchunks; ++c) {
+    for (size_t i = 0; i < found[c].size(); ++i) {
+      uint64_t bit = found[c][i] >> 1;
+      if (!blockEnd.empty() && blockEnd.back() == 0)
+        blockEnd.back() = bit;
+      if (!(found[c][i] & 1)) {
+        blockStart.push_back(bit);
+        blockEnd.push_back(0);
+      }
+    }
+  }
+
+  // Every block must be closed by a later magic number
+  if (!blockEnd.empty() && blockEnd.back() == 0) {
+    blockStart.clear();
+    blockEnd.clear();
+  }
+
+  if (READER_DEBUG)
+    printf("Found %zu bzip2 blocks\n", blockStart.size());
+}
+
+// Decompress block b by wrapping it in a bzip2 stream of its own
+bool Bz2Reader::decompressBlock(size_t b, vector<char> &out) const {
+  uint64_t start = blockStart[b];
+  uint64_t nbits = blockEnd[b] - start;
+  // The CRC of a one-block stream is the CRC of its block
+  uint64_t crc = getBits(start + 48, 32);
+
+  vector<char> in;
+  in.reserve((nbits >> 3) + 16);
+  BitWriter bw(in);
+  bw.put('B', 8);
+  bw.put('Z', 8);
+  bw.put('h', 8);
+  bw.put('9', 8);
+  bw.copy(data, start, nbits);
+  bw.put(BZ2_EOS_MAGIC, 48);
+  bw.put(crc, 32);
+  bw.flush();
+
+  bz_stream s;
+  memset(&s, 0, sizeof(s));
+  if (BZ2_bzDecompressInit(&s, 0, 0) != BZ_OK)
+    return false;
+
+  out.resize(1 << 20);
+  s.next_in = in.data();
+  s.avail_in = in.size();
+  int ret;
+  do {
+    if (s.total_out_lo32 == out.size())
+      out.resize(2 * out.size());
+    s.next_out = out.data() + s.total_out_lo32;
+    s.avail_out = out.size() - s.total_out_lo32;
+    ret = BZ2_bzDecompress(&s);
+  } while (ret == BZ_OK && (s.avail_out == 0 || s.avail_in > 0));
+
+  out.resize(s.total_out_lo32);
+  BZ2_bzDecompressEnd(&s);
+  return ret == BZ_STREAM_END;
+}
+
+// Decompress the next batch of blocks in parallel.  Returns false at
+// the end of the input, or after falling back to serial decompression.
+bool Bz2Reader::nextBatch() {
+  size_t nblocks =
+      min(blockStart.size() - nextBlock,
+          (size_t)(__cilkrts_get_nworkers() * BZ2_BLOCKS_PER_WORKER));
+  if (nblocks == 0)
+    return false;
+
+  batch.resize(nblocks);
+  bool ok = true;
+  cilk_for(size_t b = 0; b < nblocks; ++b) {
+    if (!decompressBlock(nextBlock + b, batch[b]))
+      ok = false;
+  }
+
+  if (!ok) {
+    // A magic number occurred inside a block's compressed data, or the
+    // input is corrupt.  Let serial decompression sort it out.
+    if (READER_DEBUG)
+      printf("Falling back to serial bzip2 decompression\n");
+    batch.clear();
+    startSerial();
+    return false;
+  }
+
+  nextBlock += nblocks;
+  batchBlock = 0;
+  batchOffset = 0;
+  return true;
+}
+
+void Bz2Reader::startSerial() {
+  serial = true;
+  memset(&strm, 0, sizeof(strm));
+  BZ2_bzDecompressInit(&strm, 0, 0);
+  strmIn = 0;
+
+  // Skip the bytes already delivered by parallel decompression
+  size_t skip = delivered;
+  delivered = 0;
+  char buf[1 << 16];
+  while (skip > 0) {
+    size_t got = readSerial(buf, min(skip, sizeof(buf)));
+    if (got == 0)
+      break;
+    skip -= got;
+  }
+}
+
+size_t Bz2Reader::readSerial(char *buf, size_t n) {
+  size_t done = 0;
+  while (done < n && strmIn < size) {
+    strm.next_in = (char *)data + strmIn;
+    strm.avail_in = min(size - strmIn, (size_t)1 << 30);
+    strm.next_out = buf + done;
+    strm.avail_out = min(n - done, (size_t)1 << 30);
+    int ret = BZ2_bzDecompress(&strm);
+    strmIn = (const unsigned char *)strm.next_in - data;
+    done = (strm.next_out - buf);
+
+    if (ret == BZ_STREAM_END) {
+      // Continue with the next concatenated stream, if any
+      BZ2_bzDecompressEnd(&strm);
+      memset(&strm, 0, sizeof(strm));
+      BZ2_bzDecompressInit(&strm, 0, 0);
+    } else if (ret != BZ_OK) {
+      fprintf(stderr, "bzip2 decompression failed (%d)\n", ret);
+      strmIn = size;
+    }
+  }
+  delivered += done;
+  return done;
+}
+
+size_t Bz2Reader::read(void *buf, size_t n) {
+  char *out = (char *)buf;
+  size_t done = 0;
+
+  while (done < n && !serial) {
+    if (batchBlock == batch.size() && !nextBatch())
+      break;
+    if (batchBlock == batch.size())
+      continue;
+
+    vector<char> &blk = batch[batchBlock];
+    size_t len = min(n - done, blk.size() - batchOffset);
+    memcpy(out + done, blk.data() + batchOffset, len);
+    done += len;
+    batchOffset += len;
+    delivered += len;
+    if (batchOffset == blk.size()) {
+      vector<char>().swap(blk);
+      ++batchBlock;
+      batchOffset = 0;
+    }
+  }
+
+  if (serial && done < n)
+    done += readSerial(out + done, n - done);
+  return done;
+}
+
+static bool endsWith(const string &s, const string &suffix) {
+  return s.size() >= suffix.size() &&
+         s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+GraphReader *openGraphReader(const string &filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return NULL;
+  }
+
+  if (!endsWith(filename, ".bz2")) {
+    if (S_ISREG(st.st_mode))
+      return new PrefetchReader(fd, st.st_size);
+    // Pipes and the like cannot be read at an offset
+    FILE *f = fdopen(fd, "r");
+    if (!f)
+      close(fd);
+    return f ? new FileReader(f) : NULL;
+  }
+
+  if (st.st_size == 0) {
+    close(fd);
+    return NULL;
+  }
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return NULL;
+
+  return new Bz2Reader((const unsigned char *)data, st.st_size);
+}
+
+// Bytes of text parsed by each strand
+const size_t TEXT_CHUNK = 1 << 20;
+// Entries handled by each strand when mirroring a symmetric matrix
+const int MIRROR_BLOCK = 1 << 16;
+
+// Contents of a text file.  Plain files are mapped into memory; others,
+// such as compressed files, are read in full through a GraphReader.
+class TextBuffer {
+private:
+  bool mapped;
+  vector<char> owned;
+
+public:
+  const char *data;
+  size_t size;
+
+  TextBuffer() : mapped(false), data(NULL), size(0) {}
+  ~TextBuffer() {
+    if (mapped)
+      munmap((void *)data, size);
+  }
+
+  bool load(const string &filename);
+};
+
+bool TextBuffer::load(const string &filename) {
+  if (!endsWith(filename, ".bz2")) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+      void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      close(fd);
+      if (p == MAP_FAILED)
+        return false;
+      data = (const char *)p;
+      size = st.st_size;
+      mapped = true;
+      return true;
+    }
+    close(fd);
+  }
+
+  GraphReader *r = openGraphReader(filename);
+  if (!r)
+    return false;
+  size_t got;
+  owned.resize(1 << 20);
+  while ((got = r->read(owned.data() + size, owned.size() - size)) > 0) {
+    size += got;
+    if (size == owned.size())
+      owned.resize(2 * owned.size());
+  }
+  delete r;
+  data = owned.data();
+  return true;
+}
+
+static inline bool isBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool isDigit(char c) { return (unsigned char)(c - '0') <= 9; }
+
+// Returns the start of the first line that begins at or after p
+static const char *lineStart(const char *begin, const char *end,
+                             const char *p) {
+  if (p <= begin)
+    return begin;
+  if (p >= end)
+    return end;
+  const char *q = (const char *)memchr(p - 1, '\n', end - (p - 1));
+  return q ? q + 1 : end;
+}
+
+static inline const char *lineEnd(const char *p, const char *end) {
+  const char *q = (const char *)memchr(p, '\n', end - p);
+  return q ? q : end;
+}
+
+// An entry line starts with a digit; all others are blank or comments
+static inline bool isEntry(const char *p, const char *eol) {
+  while (p < eol && isBlank(*p))
+    ++p;
+  return p < eol && isDigit(*p);
+}
+
+// Parse the unsigned integer at p, after any blanks.  Returns the end
+// of the integer, or NULL if there is none or it does not fit in an int.
+static inline const char *parseIndex(const char *p, const char *eol,
+                                     long *v) {
+  while (p < eol && isBlank(*p))
+    ++p;
+  if (p == eol || !isDigit(*p))
+    return NULL;
+  long x = 0;
+  do {
+    x = x * 10 + (*p++ - '0');
+    if (x > INT32_MAX)
+      return NULL;
+  } while (p < eol && isDigit(*p));
+  if (p < eol && !isBlank(*p))
+    return NULL;
+  *v = x;
+  return p;
+}
+
+// Parse the number at p, after any blanks.  Returns the end of the
+// number, or NULL if there is none.
+static inline const char *parseValue(const char *p, const char *eol,
+                                     double *v) {
+  while (p < eol && isBlank(*p))
+    ++p;
+  // Copy the number out, since the text need not be NUL-terminated
+  char buf[64];
+  size_t len = 0;
+  while (p + len < eol && !isBlank(p[len]) && len < sizeof(buf) - 1) {
+    buf[len] = p[len];
+    ++len;
+  }
+  buf[len] = 0;
+  char *stop;
+  *v = strtod(buf, &stop);
+  return len > 0 && stop == buf + len ? p + len : NULL;
+}
+
+// Parse the entry lines in [begin, end) in parallel.  Each entry line
+// starts with a pair of indices, which are stored less base, followed
+// by a value, which is stored if el->vals is set and ignored otherwise.
+// Returns the number of entries, or -1 on error.
+static long parseEntries(const char *begin, const char *end, int base,
+                         EdgeList *el, bool values) {
+  size_t size = end - begin;
+  size_t nchunks = (size + TEXT_CHUNK - 1) / TEXT_CHUNK;
+  vector<long> offset(nchunks + 1, 0);
+
+  // Count the entries in each chunk, to find where each chunk's entries
+  // go, then parse them into place
+  cilk_for(size_t c = 0; c < nchunks; ++c) {
+    const char *p = lineStart(begin, end, begin + c * TEXT_CHUNK);
+    const char *stop =
+        lineStart(begin, end, begin + min(size, (c + 1) * TEXT_CHUNK));
+    long count = 0;
+    for (; p < stop; ++p) {
+      const char *eol = lineEnd(p, stop);
+      count += isEntry(p, eol);
+      p = eol;
+    }
+    offset[c + 1] = count;
+  }
+  for (size_t c = 0; c < nchunks; ++c)
+    offset[c + 1] += offset[c];
+
+  long nnz = offset[nchunks];
+  if (nnz > INT32_MAX)
+    return -1;
+  el->nnz = nnz;
+  el->rows = new int[nnz];
+  el->cols = new int[nnz];
+  el->vals = values ? new double[nnz] : NULL;
+
+  bool bad = false;
+  vector<long> maxIndex(nchunks, -1);
+  cilk_for(size_t c = 0; c < nchunks; ++c) {
+    const char *p = lineStart(begin, end, begin + c * TEXT_CHUNK);
+    const char *stop =
+        lineStart(begin, end, begin + min(size, (c + 1) * TEXT_CHUNK));
+    long k = offset[c], mx = -1;
+    for (; p < stop; ++p) {
+      const char *eol = lineEnd(p, stop);
+      if (isEntry(p, eol)) {
+        long i, j;
+        const char *q = parseIndex(p, eol, &i);
+        if (q)
+          q = parseIndex(q, eol, &j);
+        if (q && values)
+          q = parseValue(q, eol, &el->vals[k]);
+        if (!q || i < base || j < base) {
+          __atomic_store_n(&bad, true, __ATOMIC_RELAXED);
+          break;
+        }
+        el->rows[k] = i - base;
+        el->cols[k] = j - base;
+        mx = max(mx, max(i, j) - base);
+        ++k;
+      }
+      p = eol;
+    }
+    maxIndex[c] = mx;
+  }
+
+  el->n = 0;
+  for (size_t c = 0; c < nchunks; ++c)
+    el->n = max(el->n, (int)maxIndex[c] + 1);
+  if (bad) {
+    delete[] el->rows;
+    delete[] el->cols;
+    delete[] el->vals;
+    return -1;
+  }
+  return nnz;
+}
+
+// Append the mirror image (j, i) of each off-diagonal entry (i, j), with
+// its value negated if the matrix is skew-symmetric.  Returns false if
+// there would be too many entries.
+static bool mirrorEntries(EdgeList *el, bool skew) {
+  int nnz = el->nnz;
+  int nblocks = (nnz + MIRROR_BLOCK - 1) / MIRROR_BLOCK;
+  vector<long> offset(nblocks + 1, 0);
+
+  cilk_for(int b = 0; b < nblocks; ++b) {
+    int end = min(nnz, (b + 1) * MIRROR_BLOCK);
+    long count = 0;
+    for (int k = b * MIRROR_BLOCK; k < end; ++k)
+      count += el->rows[k] != el->cols[k];
+    offset[b + 1] = count;
+  }
+  for (int b = 0; b < nblocks; ++b)
+    offset[b + 1] += offset[b];
+
+  long total = nnz + offset[nblocks];
+  if (total > INT32_MAX)
+    return false;
+  int *rows = new int[total];
+  int *cols = new int[total];
+  double *vals = el->vals ? new double[total] : NULL;
+  cilk_for(int b = 0; b < nblocks; ++b) {
+    int start = b * MIRROR_BLOCK;
+    int end = min(nnz, start + MIRROR_BLOCK);
+    memcpy(rows + start, el->rows + start, (end - start) * sizeof(int));
+    memcpy(cols + start, el->cols + start, (end - start) * sizeof(int));
+    if (vals)
+      memcpy(vals + start, el->vals + start, (end - start) * sizeof(double));
+    long m = nnz + offset[b];
+    for (int k = start; k < end; ++k) {
+      if (el->rows[k] != el->cols[k]) {
+        rows[m] = el->cols[k];
+        cols[m] = el->rows[k];
+        if (vals)
+          vals[m] = skew ? -el->vals[k] : el->vals[k];
+        ++m;
+      }
+    }
+  }
+
+  delete[] el->rows;
+  delete[] el->cols;
+  delete[] el->vals;
+  el->rows = rows;
+  el->cols = cols;
+  el->vals = vals;
+  el->nnz = total;
+  return true;
+}
+
+int readMatrixMarket(const string &filename, EdgeList *el, bool values) {
+  TextBuffer text;
+  if (!text.load(filename)) {
+    fprintf(stderr, "Problem reading text input file %s\n", filename.c_str());
+    return -1;
+  }
+  const char *p = text.data, *end = text.data + text.size;
+
+  // Banner: %%MatrixMarket matrix coordinate <field> <symmetry>
+  const char *eol = lineEnd(p, end);
+  string banner(p, eol);
+  for (size_t i = 0; i < banner.size(); ++i)
+    banner[i] = tolower(banner[i]);
+  char object[32], format[32], field[32], symmetry[32];
+  if (sscanf(banner.c_str(), "%%%%matrixmarket %31s %31s %31s %31s", object,
+             format, field, symmetry) != 4 ||
+      strcmp(object, "matrix") != 0 || strcmp(format, "coordinate") != 0) {
+    fprintf(stderr, "Input file %s is not a Matrix Market coordinate file\n",
+            filename.c_str());
+    return -1;
+  }
+  bool symmetric = strcmp(symmetry, "general") != 0;
+  bool skew = strcmp(symmetry, "skew-symmetric") == 0;
+  // Complex values are ignored, as are the values of pattern matrices,
+  // which have none
+  values = values &&
+           (strcmp(field, "real") == 0 || strcmp(field, "integer") == 0);
+
+  // Size line, after any comments: <rows> <columns> <entries>
+  long m = 0, n = 0, nnz = -1;
+  for (p = eol; p < end && nnz < 0; p = eol) {
+    p = p + 1;
+    eol = lineEnd(p, end);
+    if (!isEntry(p, eol))
+      continue;
+    string line(p, eol);
+    if (sscanf(line.c_str(), "%ld %ld %ld", &m, &n, &nnz) != 3)
+      break;
+  }
+  if (m <= 0 || n <= 0 || nnz <= 0 || m > INT32_MAX) {
+    fprintf(stderr, "Problem with matrix size in text input file %s\n",
+            filename.c_str());
+    return -1;
+  }
+  if (m != n) {
+    fprintf(stderr, "Input file %s does not describe a graph\n",
+            filename.c_str());
+    return -1;
+  }
+
+  long count = parseEntries(p < end ? p + 1 : end, end, 1, el, values);
+  if (count < 0 || count != nnz || el->n > m) {
+    if (count >= 0) {
+      delete[] el->rows;
+      delete[] el->cols;
+      delete[] el->vals;
+    }
+    fprintf(stderr, "Problem with entries in text input file %s\n",
+            filename.c_str());
+    return -1;
+  }
+  el->n = m;
+
+  if (symmetric && !mirrorEntries(el, skew)) {
+    delete[] el->rows;
+    delete[] el->cols;
+    delete[] el->vals;
+    fprintf(stderr, "Too many entries in text input file %s\n",
+            filename.c_str());
+    return -1;
+  }
+  return 0;
+}
+
+int readEdgeList(const string &filename, EdgeList *el) {
+  TextBuffer text;
+  if (!text.load(filename)) {
+    fprintf(stderr, "Problem reading text input file %s\n", filename.c_str());
+    return -1;
+  }
+
+  long count = parseEntries(text.data, text.data + text.size, 0, el, false);
+  if (count <= 0) {
+    if (count == 0) {
+      delete[] el->rows;
+      delete[] el->cols;
+    }
+    fprintf(stderr, "Problem with entries in text input file %s\n",
+            filename.c_str());
+    return -1;
+  }
+  return 0;
+}
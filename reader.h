@@ -0,0 +1,65 @@
+// Copyright (c) 2010-2024, Tao B. Schardl
+/*
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef READER_H
+#define READER_H
+
+#include <cstddef>
+#include <string>
+
+// Sequential byte stream over a graph input file
+class GraphReader {
+public:
+  virtual ~GraphReader() {}
+
+  // Read up to n bytes into buf.  Returns the number of bytes read,
+  // which is less than n only at the end of the stream or on error.
+  virtual size_t read(void *buf, size_t n) = 0;
+};
+
+// Open filename for reading.  Files whose names end in .bz2 are
+// decompressed on the fly.  Returns NULL if the file cannot be opened.
+GraphReader *openGraphReader(const std::string &filename);
+
+// Edges of a graph in coordinate format, with 0-based vertex indices
+struct EdgeList {
+  int n;
+  int nnz;
+  int *rows;
+  int *cols;
+  // Value of each edge, or NULL
+  double *vals;
+};
+
+// Parse a Matrix Market coordinate file, adding the mirror image of
+// each off-diagonal entry of a symmetric matrix.  The values are kept
+// if values is set and the file has them.  Returns 0 on success.
+int readMatrixMarket(const std::string &filename, EdgeList *el,
+                     bool values = false);
+
+// Parse a SNAP-style edge list: one "src dst" pair per line, with
+// comments starting with '#'.  Returns 0 on success.
+int readEdgeList(const std::string &filename, EdgeList *el);
+
+#endif
@@ -22,46 +22,80 @@
  * SOFTWARE.
  */
 
-#include "graph.h"
+#ifndef UTIL_H
+#define UTIL_H
+
+#include "pbfs.h"
+#include <climits>
 #include <cstdio>
 #include <cstdlib>
 #include <string>
 
 using namespace std;
 
-const bool UTIL_DEBUG = false;
-
 // List of valid BFS algorithms to choose from.
 enum ALG_SELECT {
   BFS = 0,
   PBFS = 1,
-  // PBFS_WLS = 2,
+  PBFS_WLS = 2,
+  PBFS_COMPACT = 3,
+  PBFS_DO = 4,
+  SSSP = 5,
+  PBFS_BOUNDED = 6,
+  PBFS_BIDIR = 7,
+  PBFS_BALANCED = 8,
   NULL_ALG
 };
 
-static const char *ALG_ABBR[] = {"b", "p",
-                                 // "w",
-                                 "NULL"};
+static const char *ALG_ABBR[] = {"b", "p", "w", "c", "d",
+                                 "s", "k", "i", "e", "NULL"};
 
-static const char *ALG_NAMES[] = {"Serial BFS", "PBFS",
-                                  // "PBFS_WLS",
-                                  "NULL"};
+static const char *ALG_NAMES[] = {"Serial BFS",    "PBFS",
+                                  "PBFS_WLS",      "PBFS_COMPACT",
+                                  "PBFS_DO",       "SSSP",
+                                  "PBFS_BOUNDED",  "PBFS_BIDIR",
+                                  "PBFS_BALANCED", "NULL"};
 
 const ALG_SELECT DEFAULT_ALG_SELECT = PBFS;
+const int DEFAULT_TRIALS = 10;
 
 // Structure defining command line argument values
 typedef struct {
   string filename;
+  string generator;
   ALG_SELECT alg_select;
   bool check_correctness;
+  bool symmetrize;
+  bool no_self_loops;
+  bool no_duplicates;
+  double delta;
+  unsigned int max_depth;
+  unsigned int max_visited;
+  int source;
+  int target;
+  int trials;
+  string output;
+  bool report;
+  bool count_events;
+  int scale_workers;
+  string cilkscale_program;
 } BFSArgs;
 
 // Print the usage for this program
 static void print_usage(char *argv0) {
-  fprintf(stderr, "Usage: %s [-f <filename>] [-a <algorithm>] [-c]\n", argv0);
+  fprintf(stderr,
+          "Usage: %s [-f <filename> | -g <generator>] [-a <algorithm>] [-c] "
+          "[-S] [-L] [-U] [-s <source>] [-n <trials>] [-d <delta>] "
+          "[-k <depth>] [-m <count>] [-t <target>] [-o <filename>] [-r] "
+          "[-P <workers>] [-W <program>] [-H]\n",
+          argv0);
   fprintf(stderr, "Flags are:\n");
   fprintf(stderr,
           "\t-f <filename>\t: Specify the name of the test file to use.\n");
+  fprintf(stderr, "\t-g <generator>\t: Generate the graph instead: "
+                  "kron:<scale>[:<edgefactor>[:<seed>]],\n"
+                  "\t\t\t  grid:<side>[:<dims>] or "
+                  "er:<nodes>[:<degree>[:<seed>]].\n");
   fprintf(stderr, "\t-a <algorithm>\t: Specify the BFS algorithm to use.\n");
   fprintf(stderr, "\tValid values for <algorithm> are:\n");
   for (int i = 0; i < NULL_ALG; ++i) {
@@ -71,18 +105,57 @@ static void print_usage(char *argv0) {
     fprintf(stderr, "\n");
   }
   fprintf(stderr, "\t-c\t\t: Check result for correctness.\n");
+  fprintf(stderr, "\t-S\t\t: Add the reverse of each edge that has none.\n");
+  fprintf(stderr, "\t-L\t\t: Remove self loops.\n");
+  fprintf(stderr, "\t-U\t\t: Remove duplicate edges.\n");
+  fprintf(stderr, "\t-s <source>\t: Source node (default: 0).\n");
+  fprintf(stderr, "\t-n <trials>\t: Number of trials (default: %d).\n",
+          DEFAULT_TRIALS);
+  fprintf(stderr, "\t-d <delta>\t: Bucket width for SSSP (default: the "
+                  "average edge weight).\n");
+  fprintf(stderr, "\t-k <depth>\t: Maximum depth for PBFS_BOUNDED.\n");
+  fprintf(stderr,
+          "\t-m <count>\t: Maximum nodes visited by PBFS_BOUNDED.\n");
+  fprintf(stderr, "\t-t <target>\t: Target node for PBFS_BIDIR (default: "
+                  "the last node).\n");
+  fprintf(stderr, "\t-o <filename>\t: Write the loaded graph as a CSR graph "
+                  "file.\n");
+  fprintf(stderr, "\t-r\t\t: Print only the fastest trial's time, work, "
+                  "span and burdened span, the edges traversed, the load "
+                  "time and the failed checks, as CSV.\n");
+  fprintf(stderr, "\t-P <workers>\t: Report the speedups on 1 to <workers> "
+                  "workers as CSV.\n");
+  fprintf(stderr, "\t-W <program>\t: Cilkscale build of bfs run by -P "
+                  "(default: bfs-cilkscale).\n");
+  fprintf(stderr, "\t-H\t\t: Count hardware events in each trial and "
+                  "layer.\n");
 
   exit(1);
 }
 
 // Parse command line arguments
-BFSArgs parse_args(int argc, char *argv[]) {
+static inline BFSArgs parse_args(int argc, char *argv[]) {
   BFSArgs theArgs;
   bool found_filename = false;
 
   theArgs.alg_select = DEFAULT_ALG_SELECT;
   theArgs.filename = "";
+  theArgs.generator = "";
   theArgs.check_correctness = false;
+  theArgs.symmetrize = false;
+  theArgs.no_self_loops = false;
+  theArgs.no_duplicates = false;
+  theArgs.delta = 0;
+  theArgs.max_depth = UINT_MAX;
+  theArgs.max_visited = UINT_MAX;
+  theArgs.source = 0;
+  theArgs.target = -1;
+  theArgs.trials = DEFAULT_TRIALS;
+  theArgs.output = "";
+  theArgs.report = false;
+  theArgs.count_events = false;
+  theArgs.scale_workers = 0;
+  theArgs.cilkscale_program = "";
 
   for (int arg_i = 1; arg_i < argc; ++arg_i) {
     char *arg = argv[arg_i];
@@ -90,6 +163,75 @@ BFSArgs parse_args(int argc, char *argv[]) {
     if (strcmp(arg, "-c") == 0) {
       theArgs.check_correctness = true;
 
+    } else if (strcmp(arg, "-S") == 0) {
+      theArgs.symmetrize = true;
+
+    } else if (strcmp(arg, "-L") == 0) {
+      theArgs.no_self_loops = true;
+
+    } else if (strcmp(arg, "-U") == 0) {
+      theArgs.no_duplicates = true;
+
+    } else if (strcmp(arg, "-d") == 0) {
+      if (++arg_i >= argc)
+        print_usage(argv[0]);
+      else
+        theArgs.delta = atof(argv[arg_i]);
+
+    } else if (strcmp(arg, "-k") == 0) {
+      if (++arg_i >= argc)
+        print_usage(argv[0]);
+      else
+        theArgs.max_depth = strtoul(argv[arg_i], NULL, 10);
+
+    } else if (strcmp(arg, "-m") == 0) {
+      if (++arg_i >= argc)
+        print_usage(argv[0]);
+      else
+        theArgs.max_visited = strtoul(argv[arg_i], NULL, 10);
+
+    } else if (strcmp(arg, "-s") == 0) {
+      if (++arg_i >= argc)
+        print_usage(argv[0]);
+      else
+        theArgs.source = atoi(argv[arg_i]);
+
+    } else if (strcmp(arg, "-n") == 0) {
+      if (++arg_i >= argc)
+        print_usage(argv[0]);
+      else
+        theArgs.trials = atoi(argv[arg_i]);
+
+    } else if (strcmp(arg, "-t") == 0) {
+      if (++arg_i >= argc)
+        print_usage(argv[0]);
+      else
+        theArgs.target = atoi(argv[arg_i]);
+
+    } else if (strcmp(arg, "-o") == 0) {
+      if (++arg_i >= argc)
+        print_usage(argv[0]);
+      else
+        theArgs.output = argv[arg_i];
+
+    } else if (strcmp(arg, "-r") == 0) {
+      theArgs.report = true;
+
+    } else if (strcmp(arg, "-H") == 0) {
+      theArgs.count_events = true;
+
+    } else if (strcmp(arg, "-P") == 0) {
+      if (++arg_i >= argc)
+        print_usage(argv[0]);
+      else
+        theArgs.scale_workers = atoi(argv[arg_i]);
+
+    } else if (strcmp(arg, "-W") == 0) {
+      if (++arg_i >= argc)
+        print_usage(argv[0]);
+      else
+        theArgs.cilkscale_program = argv[arg_i];
+
     } else if (strcmp(arg, "-f") == 0) {
       if (++arg_i >= argc) {
         print_usage(argv[0]);
@@ -98,6 +240,14 @@ BFSArgs parse_args(int argc, char *argv[]) {
         found_filename = true;
       }
 
+    } else if (strcmp(arg, "-g") == 0) {
+      if (++arg_i >= argc) {
+        print_usage(argv[0]);
+      } else {
+        theArgs.generator = argv[arg_i];
+        found_filename = true;
+      }
+
     } else if (strcmp(arg, "-a") == 0) {
       if (++arg_i >= argc) {
         print_usage(argv[0]);
@@ -125,98 +275,4 @@ BFSArgs parse_args(int argc, char *argv[]) {
   return theArgs;
 }
 
-static int CumulativeSum(int *arr, int size) {
-  int prev;
-  int tempnz = 0;
-  for (int i = 0; i < size; ++i) {
-    prev = arr[i];
-    arr[i] = tempnz;
-    tempnz += prev;
-  }
-  return tempnz;
-}
-
-int parseBinaryFile(const string filename, Graph **graph) {
-  int m, n, nnz;
-
-  // Read binary CSB matrix input
-  // Code and matrices adapted from oskitest.cpp by Aydin Buluc
-  if (UTIL_DEBUG)
-    printf("Reading input file %s\n", filename.c_str());
-
-  FILE *f = fopen(filename.c_str(), "r");
-  if (!f) {
-    fprintf(stderr, "Problem reading binary input file %s\n", filename.c_str());
-    return -1;
-  }
-
-  fread(&m, sizeof(int), 1, f);
-  fread(&n, sizeof(int), 1, f);
-  fread(&nnz, sizeof(int), 1, f);
-
-  if (m <= 0 || n <= 0 || nnz <= 0) {
-    fprintf(stderr, "Problem with matrix size in binary input file %s\n",
-            filename.c_str());
-    return -1;
-  }
-
-  if (m != n) {
-    fprintf(stderr, "Input file %s does not describe a graph\n",
-            filename.c_str());
-    return -1;
-  }
-
-  if (UTIL_DEBUG)
-    printf("Reading %d-by-%d matrix having %d nonzeros\n", m, n, nnz);
-
-  int *rowindices = new int[nnz];
-  int *colindices = new int[nnz];
-  double *vals = new double[nnz];
-
-  size_t rows = fread(rowindices, sizeof(int), nnz, f);
-  size_t cols = fread(colindices, sizeof(int), nnz, f);
-  size_t nums = fread(vals, sizeof(double), nnz, f);
-  fclose(f);
-
-  if (rows != nnz || cols != nnz || nums != nnz) {
-    fprintf(stderr, "Problem with FREAD. Aborting.\n");
-    return -1;
-  }
-  // Csc<double, int> csc(rowindices, colindices, vals, nnz, m, n);
-  double *num = new double[nnz];
-  int *ir = new int[nnz];
-  int *jc = new int[n + 1];
-  int *w = new int[n];
-
-  for (int k = 0; k < n; ++k)
-    w[k] = 0;
-
-  for (int k = 0; k < nnz; ++k)
-    w[colindices[k]]++;
-
-  jc[n] = CumulativeSum(w, n);
-  for (int k = 0; k < n; ++k)
-    jc[k] = w[k];
-
-  int last;
-  for (int k = 0; k < nnz; ++k) {
-    ir[last = w[colindices[k]]++] = rowindices[k];
-    num[last] = vals[k];
-  }
-
-  delete[] w;
-  delete[] rowindices;
-  delete[] colindices;
-  delete[] vals;
-
-  if (UTIL_DEBUG)
-    printf("Making graph\n");
-
-  *graph = new Graph(ir, jc, m, n, nnz);
-
-  delete[] ir;
-  delete[] jc;
-  delete[] num;
-
-  return 0;
-}
+#endif // UTIL_H